@@ -0,0 +1,87 @@
+/**
+ ******************************************************************************
+ * @file      gps_clock.h
+ * @author    Gabriel F P Araujo
+ * @date      17/10/2026
+ ******************************************************************************
+ *
+ * @attention Copyright (C) 2018
+ * @attention Laboratório de Automação e Robótica (LARA)
+ * @attention Departamento de Engenharia Elétrica (ENE)
+ * @attention Universidade de Brasília (UnB)
+ *
+ *
+ *
+ ******************************************************************************
+ *
+ ** ### GPS time from the local clock ###
+ *
+ *  Keeps gps = local + offset + drift*(local - reference), all in
+ *  microseconds (GPS time counted from the GPS epoch, week*604800 s + TOW).
+ *  Each measurement pairs a GPS time with the local time it happened at:
+ *
+ *  (#) GPSCLOCK_frame    Frame header time (week, ms) with the local time of
+ *                        its first sync byte. Carries the receiver's output
+ *                        latency, which only ever delays: per 1 s window the
+ *                        least delayed frame is used, its (constant) latency
+ *                        goes into the offset
+ *  (#) GPSCLOCK_pps      Local time of a PPS edge (timer input capture). The
+ *                        next frame names the second, the edge gives the
+ *                        instant. While pulses arrive frames are not used
+ *
+ *  Offset and drift follow the residual with fixed gains, larger while
+ *  acquiring. Residuals past the gate are outliers; a run of them re-steps
+ *  the model.
+ *  Everything is integer, GPSCLOCK_gpsTimeFromLocal is cheap enough to stamp
+ *  samples in their interrupt. It gives 0 before the first measurement and
+ *  for a local time of 0 (sample never stamped).
+ */
+
+#ifndef GPS_CLOCK_H
+#define GPS_CLOCK_H
+
+#define GPS_WEEK_US             604800000000ULL
+
+#define GPSCLOCK_WINDOW_US      1000000 // Frames per measurement window
+#define GPSCLOCK_FRAME_GATE_US  2000
+#define GPSCLOCK_PPS_GATE_US    200
+#define GPSCLOCK_ACQUIRE_GATE   10      // Gate widening until locked
+#define GPSCLOCK_PPS_TIMEOUT_US 2000000 // Back to frames after 2 s without PPS
+#define GPSCLOCK_MAX_OUTLIERS   5       // In a row, before re-stepping
+#define GPSCLOCK_LOCK_UPDATES   20
+#define GPSCLOCK_MAX_DRIFT      2147484 // 500 ppm, Q32
+#define GPSCLOCK_OFFSET_GAIN    8       // 1/8 of the residual
+#define GPSCLOCK_DRIFT_GAIN     64      // 1/64 of the residual rate
+#define GPSCLOCK_ACQUIRE_OFFSET_GAIN 2
+#define GPSCLOCK_ACQUIRE_DRIFT_GAIN  4
+
+typedef struct
+{
+    // Model, written under interrupt lock
+    uint64_t reference;         // Local time of the last update [us]
+    int64_t offset;             // gps - local at reference [us]
+    int32_t drift;              // Q32 [s/s], local clock slow when positive
+
+    uint8_t locked;
+    uint8_t ppsPending;
+    uint64_t ppsLocal;          // Last edge
+    uint64_t ppsUpdate;         // Last update made from an edge
+
+    // Frame window: least delayed frame so far
+    uint64_t windowStart;
+    uint64_t windowGps, windowLocal;
+
+    int32_t residual;           // Last accepted [us]
+    uint32_t updates;
+    uint32_t outliers;
+    uint32_t steps;
+    uint8_t outlierRun;
+}GPSClock;
+
+
+void GPSCLOCK_init(GPSClock* clock);
+void GPSCLOCK_frame(GPSClock* clock, uint16_t week, uint32_t milliseconds, uint64_t local);
+void GPSCLOCK_pps(GPSClock* clock, uint64_t local);
+uint64_t GPSCLOCK_gpsTimeFromLocal(GPSClock* clock, uint64_t local);
+
+#endif /* GPS_CLOCK_H */
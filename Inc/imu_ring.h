@@ -0,0 +1,65 @@
+/**
+ ******************************************************************************
+ * @file      imu_ring.h
+ * @author    Gabriel F P Araujo
+ * @date      17/10/2026
+ ******************************************************************************
+ *
+ * @attention Copyright (C) 2018
+ * @attention Laboratório de Automação e Robótica (LARA)
+ * @attention Departamento de Engenharia Elétrica (ENE)
+ * @attention Universidade de Brasília (UnB)
+ *
+ *
+ *
+ ******************************************************************************
+ *
+ ** ### IMU sample ring ###
+ *
+ *  Structure of arrays: each channel is a contiguous Q31 array of capacity
+ *  samples, next to an array of sample times. One producer (the sensor
+ *  interrupt) and one consumer (a task), no locking.
+ *
+ *  Storage is declared by the user with IMURING_STORAGE, so its size is
+ *  fixed at compile time: channels*capacity*4 + capacity*8 bytes.
+ *
+ *  (#) IMURING_init      Binds the storage, capacity a power of two
+ *  (#) IMURING_push      Producer, copies one sample in (dropped when full)
+ *  (#) IMURING_peek      Consumer, contiguous run of samples from the oldest.
+ *                        Runs never wrap, so batches that divide the capacity
+ *                        always come whole (8, 16 or 32 of a 32 sample ring)
+ *  (#) IMURING_channel   Consumer, the channel array the run indexes into
+ *  (#) IMURING_release   Consumer, frees the samples it is done with
+ */
+
+#ifndef IMU_RING_H
+#define IMU_RING_H
+
+// Declares the arrays of one ring
+#define IMURING_STORAGE(name, channels, capacity) \
+    int32_t name##Data[(channels)*(capacity)]; \
+    uint64_t name##Time[(capacity)]
+
+typedef struct
+{
+    int32_t* data;              // channel c at data[c*capacity]
+    uint64_t* time;
+    uint8_t channels;
+    uint32_t capacity;
+    uint32_t mask;
+
+    // Free running counts, the index is count & mask
+    volatile uint32_t head;     // Producer
+    volatile uint32_t tail;     // Consumer
+
+    uint32_t overruns;
+}IMURing;
+
+
+void IMURING_init(IMURing* ring, int32_t* data, uint64_t* time, uint8_t channels, uint32_t capacity);
+int8_t IMURING_push(IMURing* ring, const int32_t* channel, uint64_t time);
+uint32_t IMURING_peek(IMURing* ring, uint32_t maxSamples, uint32_t* offset);
+const int32_t* IMURING_channel(const IMURing* ring, uint8_t channel);
+void IMURING_release(IMURing* ring, uint32_t samples);
+
+#endif /* IMU_RING_H */
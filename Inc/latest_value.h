@@ -0,0 +1,55 @@
+/**
+ ******************************************************************************
+ * @file      latest_value.h
+ * @author    Gabriel F P Araujo
+ * @date      17/10/2026
+ ******************************************************************************
+ *
+ * @attention Copyright (C) 2018
+ * @attention Laboratório de Automação e Robótica (LARA)
+ * @attention Departamento de Engenharia Elétrica (ENE)
+ * @attention Universidade de Brasília (UnB)
+ *
+ *
+ *
+ ******************************************************************************
+ *
+ ** ### Latest value register ###
+ *
+ *  Newest sample of a sensor behind a sequence count (seqlock). The writer
+ *  makes the count odd, copies the sample in and makes it even again, it
+ *  never waits. A reader copies the sample out and starts over only when the
+ *  count changed meanwhile, so a read is one copy unless a write hit it.
+ *  Neither side disables interrupts.
+ *
+ *  One writer per register. Readers must not preempt the writer (tasks, or
+ *  interrupts of lower priority than the writer's): a reader spinning over
+ *  an odd count would never let it finish.
+ *
+ *  (#) LATESTVALUE_init    Binds the storage, nothing to read until written
+ *  (#) LATESTVALUE_write   Writer, replaces the value
+ *  (#) LATESTVALUE_read    Reader, coherent copy of the value
+ */
+
+#ifndef LATEST_VALUE_H
+#define LATEST_VALUE_H
+
+// Declares the value of one register
+#define LATESTVALUE_STORAGE(name, type) \
+    type name##Data
+
+typedef struct
+{
+    uint8_t* data;
+    uint16_t size;
+
+    // Odd while a write is under way, 0 before the first one
+    volatile uint32_t sequence;
+}LatestValue;
+
+
+void LATESTVALUE_init(LatestValue* value, void* data, uint16_t size);
+void LATESTVALUE_write(LatestValue* value, const void* sample);
+int8_t LATESTVALUE_read(const LatestValue* value, void* sample);
+
+#endif /* LATEST_VALUE_H */
@@ -18,14 +18,103 @@
 #define NANOIMU_BPS     115200
 #define MAX_BYTES       100
 
+// Device timer: 16 bit, 2.17 us (4 x 115200 Hz), 3072 ticks per sample at 150 Hz
+#define NANOIMU_TIMER_HZ    460800
+#define NANOIMU_RATE_HZ     150
+#define NANOIMU_WINDOW_US   10000000    // Timer rate measurement window
+
+// Digital sensitivities: 2^15 counts are 1.5 times the full scale (the
+// thermometer is 1/16 degC per count)
+#define DS_GYR          (1.5*300.0/32768.0)     // [deg/s]
+#define DS_ACC          (1.5*2.0/32768.0)       // [g]
+#define DS_MAG          (1.5*1.9/32768.0)       // [gauss]
+#define DS_TMP          (1.0/16.0)              // [degC]
+
+// Decoded channels: gyro, accel, mag and temperature, x y z each, in the
+// packet order
+#define NANOIMU_GYR         0
+#define NANOIMU_ACC         3
+#define NANOIMU_MAG         6
+#define NANOIMU_TMP         9
+#define NANOIMU_CHANNELS    12
+
+// Q31 fraction of a power of two full scale, per sensor:
+// value = channel * 2^NANOIMU_x_RANGE / 2^31
+#define NANOIMU_GYR_RANGE   3       // [rad/s], +-8 (7.85 at 1.5 x 300 deg/s)
+#define NANOIMU_ACC_RANGE   5       // [m/s^2], +-32 (29.4 at 1.5 x 2 g)
+#define NANOIMU_MAG_RANGE   2       // [gauss], +-4 (2.85 at 1.5 x 1.9 gauss)
+#define NANOIMU_TMP_RANGE   11      // [degC], whole 16 bit span
+
+typedef struct
+{
+    int32_t channel[NANOIMU_CHANNELS];
+    uint64_t ticks;             // Device timer extended to 64 bits, monotonic
+    uint64_t time;              // Local time of the sample from the ticks [us], 0 if not stamped
+}MEMSenseSample;
+
+typedef struct
+{
+    float channel[NANOIMU_CHANNELS];
+}MEMSenseSampleF;
+
+// Called from the framer (interrupt context) with each validated packet,
+// decoded. The raw packet is still in MEMSenseImu.data
+typedef void (*MEMSensePacketCallback)(const MEMSenseSample* sample, void* context);
+
 typedef struct
 {
     UART_HandleTypeDef* UARTInterface;
 
     uint16_t messageSize;
     uint8_t data[IMU_PACKET_SIZE];
+
+    // Framer state, kept between calls so packets may span several byte spans
+    uint8_t s;
+    uint8_t b;
+    uint8_t sum;                // Additive checksum of the packet so far
+    uint8_t recovering;         // Current packet was found by a rescan
+    uint32_t packetCount;
+
+    // Rejected packets are rescanned for a sync inside their own bytes
+    uint32_t bytesDiscarded;
+    uint32_t packetsRecovered;
+
+    // UART errors (HAL_UART_ERROR_x of the last one), each breaks the
+    // packet in progress
+    uint32_t lineError;
+    uint32_t lineErrors;
+
+    // Local time of the byte being parsed: span end less a character time
+    // per byte still to come in the span
+    uint64_t spanTime;
+    uint32_t spanLeft;
+    uint32_t byteTimeNs;
+    uint64_t packetTime;        // Arrival of the last packet's first byte [us]
+
+    // Device timer extension and mapping to the local clock: time =
+    // baseTime + (ticks - baseTicks)/timerRate. Each window keeps its least
+    // delayed packet, the next mapping starts from it
+    uint16_t timer;
+    uint64_t ticks;
+    uint32_t period;            // Ticks per sample, learned
+    uint32_t packetsDropped;
+    uint32_t timerRate;         // Ticks per local second
+    uint64_t baseTicks, baseTime;
+    uint64_t windowStart;
+    uint64_t bestTicks, bestTime;
+    int64_t bestLatency;
+
+    MEMSenseSample sample;
+    MEMSensePacketCallback packetCallback;
+    void* callbackContext;
 }MEMSenseImu;
 
 
 void NANOIMU_configDevice(MEMSenseImu* nanoImu, UART_HandleTypeDef* interface);
+void NANOIMU_setPacketCallback(MEMSenseImu* nanoImu, MEMSensePacketCallback callback, void* context);
+void NANOIMU_pushBytes(MEMSenseImu* nanoImu, const uint8_t* buffer, uint32_t length);
+void NANOIMU_pushBytesAt(MEMSenseImu* nanoImu, const uint8_t* buffer, uint32_t length, uint64_t lastByteTime);
+void NANOIMU_lineError(MEMSenseImu* nanoImu, uint32_t error);
 void NANOIMU_geData(MEMSenseImu* nanoImu);
+void NANOIMU_decode(const uint8_t* packet, MEMSenseSample* sample);
+void NANOIMU_toFloat(const MEMSenseSample* sample, MEMSenseSampleF* sampleF);
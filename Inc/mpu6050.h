@@ -1,13 +1,67 @@
+/* Full scale ranges (ACCEL_CONFIG AFS_SEL, GYRO_CONFIG FS_SEL) */
+#define MPU6050_ACCEL_2G        0
+#define MPU6050_ACCEL_4G        1
+#define MPU6050_ACCEL_8G        2
+#define MPU6050_ACCEL_16G       3
+#define MPU6050_GYRO_250DPS     0
+#define MPU6050_GYRO_500DPS     1
+#define MPU6050_GYRO_1000DPS    2
+#define MPU6050_GYRO_2000DPS    3
+
+/* Low pass bandwidth (CONFIG DLPF_CFG), accel/gyro. The gyro output rate is
+   8 kHz with DLPF_260HZ, 1 kHz otherwise, divided by 1 + sampleDivider */
+#define MPU6050_DLPF_260HZ      0
+#define MPU6050_DLPF_188HZ      1
+#define MPU6050_DLPF_98HZ       2
+#define MPU6050_DLPF_44HZ       3
+#define MPU6050_DLPF_21HZ       4
+#define MPU6050_DLPF_10HZ       5
+#define MPU6050_DLPF_5HZ        6
+
+/* Decoded channels: gyro, accel and temperature */
+#define MPU6050_GYR             0
+#define MPU6050_ACC             3
+#define MPU6050_TMP             6
+#define MPU6050_CHANNELS        7
+
+/* Q31 fraction of a power of two full scale, per sensor, whatever the device
+   range: value = channel * 2^MPU6050_x_RANGE / 2^31 */
+#define MPU6050_GYR_RANGE       6       /* [rad/s], +-64 (34.9 at 2000 deg/s) */
+#define MPU6050_ACC_RANGE       8       /* [m/s^2], +-256 (156.9 at 16 g) */
+#define MPU6050_TMP_RANGE       8       /* [degC], +-256 */
+
 typedef struct
 {
     uint32_t accelScaleRange;
 
     uint32_t gyroScaleRange;
 
-}MPU6050Config;
+    uint32_t dlpfConfig;
+
+    uint32_t sampleDivider;
 
+}MPU6050Config;
 
 typedef struct
+{
+    int32_t channel[MPU6050_CHANNELS];
+    uint64_t time;              /* Local time of the data ready edge [us] */
+}MPU6050Sample;
+
+
+/* Hardware FIFO: the whole sample block (accel, temperature, gyro), 14 bytes
+   per sample, the same layout as lastData */
+#define MPU6050_FIFO_SIZE       1024
+#define MPU6050_FIFO_SAMPLE     14
+#define MPU6050_FIFO_SAMPLES    16      /* Most samples drained in one burst */
+
+typedef struct MPU6050Imu MPU6050Imu;
+
+/* Called from the I2C interrupt when a read completes: one sample in lastData,
+   or fifoSamples samples in fifoData in FIFO mode */
+typedef void (*MPU6050Callback)(MPU6050Imu *imu6050, void* context);
+
+struct MPU6050Imu
 {
     I2C_HandleTypeDef *I2CInterface;
 
@@ -20,8 +74,42 @@ typedef struct
     uint32_t memSize;
 
     uint8_t lastData[14];
+    uint32_t samplePeriod;      /* [us] */
+
+    /* Data ready (INT pin) driven reads */
+    volatile uint8_t state;
+    uint64_t readyTime;
+    uint32_t samples;
+    uint32_t overruns;          /* Data ready while the previous read was on the bus */
+    uint32_t errors;
+
+    /* FIFO mode: every fifoBatch data ready edges the FIFO is drained in one
+       burst, oldest sample first */
+    uint8_t fifoMode;
+    uint8_t fifoBatch;
+    uint8_t edges;
+    uint8_t fifoResync;         /* A failed burst left the FIFO misaligned */
+    uint8_t fifoCount[2];
+    uint8_t userCtrl;
+    uint8_t fifoData[MPU6050_FIFO_SAMPLES*MPU6050_FIFO_SAMPLE];
+    uint16_t fifoSamples;
+    uint16_t fifoBacklog;       /* Samples left in the FIFO after the burst */
+    uint64_t fifoTime;          /* Data ready of the newest sample in the FIFO */
+    uint32_t fifoOverflows;
+
+    MPU6050Callback readCallback;
+    void* callbackContext;
 
-}MPU6050Imu;
+};
 
-void MPU6050_configDevice(MPU6050Imu *imu6050, I2C_HandleTypeDef* interface, uint32_t accelConfig, uint32_t gyroConfig);
+void MPU6050_configDevice(MPU6050Imu *imu6050, I2C_HandleTypeDef* interface, uint32_t accelConfig, uint32_t gyroConfig, uint32_t dlpfConfig, uint32_t sampleDivider);
+void MPU6050_configFifo(MPU6050Imu *imu6050, uint8_t batch);
+void MPU6050_start(MPU6050Imu *imu6050);
+void MPU6050_setReadCallback(MPU6050Imu *imu6050, MPU6050Callback callback, void* context);
+void MPU6050_dataReady(MPU6050Imu *imu6050, uint64_t time);
+void MPU6050_readComplete(MPU6050Imu *imu6050);
+void MPU6050_writeComplete(MPU6050Imu *imu6050);
+void MPU6050_readError(MPU6050Imu *imu6050);
 void MPU6050_geData(MPU6050Imu *imu6050);
+void MPU6050_decode(const MPU6050Imu *imu6050, const uint8_t* data, MPU6050Sample* sample);
+void MPU6050_fifoSample(const MPU6050Imu *imu6050, uint16_t index, MPU6050Sample* sample);
@@ -0,0 +1,121 @@
+/**
+ ******************************************************************************
+ * @file      nmea_parser.h
+ * @author    Gabriel F P Araujo
+ * @date      17/10/2026
+ ******************************************************************************
+ *
+ * @attention Copyright (C) 2018
+ * @attention Laboratório de Automação e Robótica (LARA)
+ * @attention Departamento de Engenharia Elétrica (ENE)
+ * @attention Universidade de Brasília (UnB)
+ *
+ *
+ *
+ ******************************************************************************
+ *
+ ** ### NMEA 0183 sentences (GGA, RMC, GSA) ###
+ *
+ *  Sentences are parsed one byte at a time, without storing them: each field
+ *  is converted when its ',' or '*' arrives and the XOR checksum is updated
+ *  with every byte. The result is handed to the callback only when the
+ *  checksum matches. Any talker id is accepted (GP, GN, GL...).
+ *
+ *  Numbers are fixed-point integers, no floating point is involved:
+ *
+ *  (#) Time        UTC time of day [ms]
+ *  (#) Position    Latitude/longitude [1e-7 deg], north/east positive
+ *  (#) Altitude    [mm]
+ *  (#) DOP         [1e-2]
+ *  (#) Speed       [1e-3 knot], course [1e-2 deg]
+ */
+
+#ifndef NMEA_PARSER_H
+#define NMEA_PARSER_H
+
+// Same values as the NovAtel log ids, so both paths share one id space
+#define NMEA_NONE       0
+#define NMEA_GGA        218
+#define NMEA_GSA        221
+#define NMEA_RMC        225
+
+#define NMEA_MAX_LENGTH 82      // '$' to <LF>, NMEA 0183 limit
+#define NMEA_GSA_PRNS   12
+
+typedef struct
+{
+    uint32_t time;
+    int32_t latitude;
+    int32_t longitude;
+    uint8_t quality;            // 0 = no fix
+    uint8_t satellites;
+    uint16_t hdop;
+    int32_t altitude;           // Above mean sea level
+    int32_t separation;         // Geoid - ellipsoid
+}NMEAGga;
+
+typedef struct
+{
+    uint32_t time;
+    uint8_t valid;              // Status 'A'
+    uint8_t mode;               // 'A', 'D', 'E', 'N' or 0 when not sent
+    int32_t latitude;
+    int32_t longitude;
+    uint32_t speed;
+    uint32_t course;
+    uint32_t date;              // ddmmyy
+}NMEARmc;
+
+typedef struct
+{
+    uint8_t mode;               // 'M' or 'A'
+    uint8_t fixType;            // 1 = none, 2 = 2D, 3 = 3D
+    uint8_t satellites;         // Used entries of prn[]
+    uint8_t prn[NMEA_GSA_PRNS];
+    uint16_t pdop, hdop, vdop;
+}NMEAGsa;
+
+typedef struct
+{
+    uint16_t messageId;         // NMEA_GGA, NMEA_RMC or NMEA_GSA
+
+    union
+    {
+        NMEAGga gga;
+        NMEARmc rmc;
+        NMEAGsa gsa;
+    }data;
+}NMEASentence;
+
+typedef void (*NMEASentenceCallback)(const NMEASentence* sentence, void* context);
+
+typedef struct
+{
+    // Parser state, kept between calls so sentences may span several byte spans
+    uint8_t s;
+    uint8_t length;
+    uint8_t field;
+    uint8_t checksum, checksum_from_packet;
+    uint32_t address;           // Last 3 characters of the address field
+
+    // Field being received
+    uint32_t value;
+    uint8_t digits, decimals, maxDecimals, fraction;
+    uint8_t negative, invalid;
+    uint8_t character;
+
+    uint32_t sentenceCount;
+    uint32_t checksumErrors;
+
+    NMEASentence sentence;
+
+    NMEASentenceCallback callback;
+    void* callbackContext;
+}NMEAParser;
+
+
+void NMEAPARSER_init(NMEAParser* parser, NMEASentenceCallback callback, void* context);
+void NMEAPARSER_parseByte(NMEAParser* parser, uint8_t data_read);
+void NMEAPARSER_pushBytes(NMEAParser* parser, const uint8_t* buffer, uint32_t length);
+
+#endif /* NMEA_PARSER_H */
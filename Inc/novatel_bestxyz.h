@@ -0,0 +1,158 @@
+/**
+ ******************************************************************************
+ * @file      novatel_bestxyz.h
+ * @author    Gabriel F P Araujo
+ * @date      17/10/2026
+ ******************************************************************************
+ *
+ * @attention Copyright (C) 2018
+ * @attention Laboratório de Automação e Robótica (LARA)
+ * @attention Departamento de Engenharia Elétrica (ENE)
+ * @attention Universidade de Brasília (UnB)
+ *
+ *
+ *
+ ******************************************************************************
+ *
+ ** ### BESTXYZB log (Firmware Reference Manual, BESTXYZ) ###
+ *
+ *  Accessors read the fields in place from a validated frame payload
+ *  (frame->data + frame->headerSize). Nothing is copied out of the frame
+ *  buffer; use them while the frame is still valid.
+ *
+ *  Axis index: 0 = X, 1 = Y, 2 = Z (ECEF).
+ */
+
+#ifndef NOVATEL_BESTXYZ_H
+#define NOVATEL_BESTXYZ_H
+
+#include "novatel_gps.h"
+
+// Payload byte order/format (offsets from the end of the header)
+#define BXYZ_PSTAT      0   // enum
+#define BXYZ_PTYPE      4   // enum
+#define BXYZ_PX         8   // double [m], then PY, PZ
+#define BXYZ_sPX        32  // float [m], then sPY, sPZ
+#define BXYZ_VSTAT      44  // enum
+#define BXYZ_VTYPE      48  // enum
+#define BXYZ_VX         52  // double [m/s], then VY, VZ
+#define BXYZ_sVX        76  // float [m/s], then sVY, sVZ
+#define BXYZ_STN_ID     88  // char[4]
+#define BXYZ_V_LATENCY  92  // float [s]
+#define BXYZ_DIFF_AGE   96  // float [s]
+#define BXYZ_SOL_AGE    100 // float [s]
+#define BXYZ_SVS        104 // uchar
+#define BXYZ_SOLN_SVS   105 // uchar
+#define BXYZ_GGL1       106 // uchar
+#define BXYZ_GGL1L2     107 // uchar
+#define BXYZ_EXT_STATUS 109 // uchar
+#define BXYZ_SIZE       112
+
+// Solution status
+#define BXYZ_SOL_COMPUTED   0
+
+// Solution copied out of the frame, for consumers that outlive it
+typedef struct
+{
+    uint64_t localTime;         // Frame time [us, TIMESTAMP_now]
+    uint32_t milliseconds;
+    uint16_t week;
+    uint8_t solutionSatellites;
+    uint32_t positionStatus;
+    double position[3];         // [m]
+    float positionSigma[3];     // [m]
+    uint32_t velocityStatus;
+    double velocity[3];         // [m/s]
+    float velocitySigma[3];     // [m/s]
+}BestxyzSample;
+
+static inline uint8_t BESTXYZ_isValid(const NovatelFrame* frame)
+{
+    return (frame->messageId == BESTXYZ) && (frame->messageSize >= BXYZ_SIZE);
+}
+
+static inline uint32_t BESTXYZ_positionStatus(const uint8_t* message)
+{
+    return NOVATEL_getU32(&message[BXYZ_PSTAT]);
+}
+
+static inline uint32_t BESTXYZ_positionType(const uint8_t* message)
+{
+    return NOVATEL_getU32(&message[BXYZ_PTYPE]);
+}
+
+static inline double BESTXYZ_position(const uint8_t* message, uint8_t axis)
+{
+    return NOVATEL_getDouble(&message[BXYZ_PX + 8*axis]);
+}
+
+static inline float BESTXYZ_positionSigma(const uint8_t* message, uint8_t axis)
+{
+    return NOVATEL_getFloat(&message[BXYZ_sPX + 4*axis]);
+}
+
+static inline uint32_t BESTXYZ_velocityStatus(const uint8_t* message)
+{
+    return NOVATEL_getU32(&message[BXYZ_VSTAT]);
+}
+
+static inline uint32_t BESTXYZ_velocityType(const uint8_t* message)
+{
+    return NOVATEL_getU32(&message[BXYZ_VTYPE]);
+}
+
+static inline double BESTXYZ_velocity(const uint8_t* message, uint8_t axis)
+{
+    return NOVATEL_getDouble(&message[BXYZ_VX + 8*axis]);
+}
+
+static inline float BESTXYZ_velocitySigma(const uint8_t* message, uint8_t axis)
+{
+    return NOVATEL_getFloat(&message[BXYZ_sVX + 4*axis]);
+}
+
+static inline float BESTXYZ_velocityLatency(const uint8_t* message)
+{
+    return NOVATEL_getFloat(&message[BXYZ_V_LATENCY]);
+}
+
+static inline float BESTXYZ_differentialAge(const uint8_t* message)
+{
+    return NOVATEL_getFloat(&message[BXYZ_DIFF_AGE]);
+}
+
+static inline float BESTXYZ_solutionAge(const uint8_t* message)
+{
+    return NOVATEL_getFloat(&message[BXYZ_SOL_AGE]);
+}
+
+static inline uint8_t BESTXYZ_trackedSatellites(const uint8_t* message)
+{
+    return message[BXYZ_SVS];
+}
+
+static inline uint8_t BESTXYZ_solutionSatellites(const uint8_t* message)
+{
+    return message[BXYZ_SOLN_SVS];
+}
+
+static inline void BESTXYZ_toSample(const NovatelFrame* frame, BestxyzSample* sample)
+{
+    const uint8_t* message = &frame->data[frame->headerSize];
+
+    sample->localTime = frame->localTime;
+    sample->milliseconds = frame->milliseconds;
+    sample->week = frame->week;
+    sample->solutionSatellites = BESTXYZ_solutionSatellites(message);
+    sample->positionStatus = BESTXYZ_positionStatus(message);
+    sample->velocityStatus = BESTXYZ_velocityStatus(message);
+    for(uint8_t axis = 0; axis < 3; axis++)
+    {
+        sample->position[axis] = BESTXYZ_position(message, axis);
+        sample->positionSigma[axis] = BESTXYZ_positionSigma(message, axis);
+        sample->velocity[axis] = BESTXYZ_velocity(message, axis);
+        sample->velocitySigma[axis] = BESTXYZ_velocitySigma(message, axis);
+    }
+}
+
+#endif /* NOVATEL_BESTXYZ_H */
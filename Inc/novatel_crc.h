@@ -0,0 +1,44 @@
+/**
+ ******************************************************************************
+ * @file      novatel_crc.h
+ * @author    Gabriel F P Araujo
+ * @date      17/10/2026
+ ******************************************************************************
+ *
+ * @attention Copyright (C) 2018
+ * @attention Laboratório de Automação e Robótica (LARA)
+ * @attention Departamento de Engenharia Elétrica (ENE)
+ * @attention Universidade de Brasília (UnB)
+ *
+ *
+ *
+ ******************************************************************************
+ *
+ ** ### NovAtel CRC-32 (Firmware Reference Manual, p.32 + APN-030) ###
+ *
+ *  Reflected polynomial 0xEDB88320, initial value 0, no final XOR. The CRC is
+ *  sent little-endian after the payload.
+ *
+ *  (#) NOVATELCRC_update    Per-byte table step, used by the framers while
+ *                           bytes are received
+ *  (#) NOVATELCRC_block     Whole buffer at once. Define NOVATEL_CRC_SLICE4
+ *                           to use slicing-by-4 (3 KB more of flash tables)
+ */
+
+#ifndef NOVATEL_CRC_H
+#define NOVATEL_CRC_H
+
+#include <stdint.h>
+
+#define NOVATEL_CRC_INIT    0x00000000UL
+
+extern const uint32_t NOVATELCRC_table[256];
+
+static inline uint32_t NOVATELCRC_update(uint32_t crc, uint8_t data)
+{
+    return (crc >> 8) ^ NOVATELCRC_table[(crc ^ data) & 0xFF];
+}
+
+uint32_t NOVATELCRC_block(uint32_t crc, const uint8_t* buffer, uint32_t count);
+
+#endif /* NOVATEL_CRC_H */
@@ -12,22 +12,204 @@
  */
 
 
+#ifndef NOVATEL_GPS_H
+#define NOVATEL_GPS_H
+
+#include "nmea_parser.h"
+
 #define D_HDR_LEN       28
+#define D_SHORT_HDR_LEN 12
 #define GPS_PACKET_SIZE 500
+#define GPS_SUBSCRIPTIONS 8     // Power of two
+#define GPS_FRAME_BUFFERS 3     // Framer, latest and consumer
+#define GPS_NO_FRAME    0xFF
+#define GPS_COMMANDS    4       // Power of two, one slot is kept free
+#define GPS_COMMAND_SIZE 64     // Including "\r\n"
+#define GPS_COMMAND_TIMEOUT 1000    // [ms], from the start of transmission
+#define GPS_REPLY_SIZE  5       // Longest reply keyword ("ERROR")
+
+#define GPS_COM_PORT    "COM1"  // Receiver port wired to the USART
+#define GPS_BAUD_PROBE_TIME 500     // [ms] without sync before trying the next rate
+#define GPS_BAUD_SETTLE_TIME 100    // [ms] after the COM command, before switching
+
+/* Command Status */
+#define GPS_CMD_OK          0   // <OK
+#define GPS_CMD_ERROR       1   // <ERROR
+#define GPS_CMD_TIMEOUT     2   // No reply
+#define GPS_CMD_TX_ERROR    3   // UART refused the transfer
+
+/* Log Message IDs */
+#define BESTPOS         42
+#define GPGGA           218
+#define GPGSA           221
+#define GPRMC           225
+#define BESTXYZ         241
+
+// Binary fields are little-endian and may sit at any alignment in the frame
+// buffer, so they are merged byte by byte (no unaligned or LDRD accesses)
+static inline uint16_t NOVATEL_getU16(const uint8_t* p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t NOVATEL_getU32(const uint8_t* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline float NOVATEL_getFloat(const uint8_t* p)
+{
+    union { uint32_t u; float f; } v;
+    v.u = NOVATEL_getU32(p);
+    return v.f;
+}
+
+static inline double NOVATEL_getDouble(const uint8_t* p)
+{
+    union { uint64_t u; double d; } v;
+    v.u = (uint64_t)NOVATEL_getU32(p) | ((uint64_t)NOVATEL_getU32(p + 4) << 32);
+    return v.d;
+}
 
 typedef struct
 {
-    UART_HandleTypeDef* UARTInterface;
+    const uint8_t* data;        // Whole frame, starting at the sync bytes
 
     uint16_t headerSize;
+    uint16_t messageId;
+    uint16_t messageSize;       // Payload only, without header and CRC
+
+    uint16_t week;
+    uint32_t milliseconds;
+
+    uint32_t sequence;          // frameCount when the frame completed
+    uint64_t localTime;         // First sync byte [us, TIMESTAMP_now], 0 if not stamped
+}NovatelFrame;
+
+typedef void (*NovatelFrameCallback)(const NovatelFrame* frame, void* context);
+
+// Header time of every frame that passes its CRC, subscribed or not: week,
+// milliseconds and the local time of the first sync byte (0 if not stamped)
+typedef void (*NovatelTimeCallback)(uint16_t week, uint32_t milliseconds, uint64_t localTime, void* context);
+
+typedef struct
+{
+    uint16_t messageId;
+    NovatelFrameCallback callback;
+    void* context;
+}NovatelSubscription;
+
+typedef void (*NovatelCommandCallback)(const char* command, uint8_t status, void* context);
+
+// Reconfigures the local UART (and its reception) to the given rate
+typedef void (*NovatelBaudCallback)(uint32_t baudRate, void* context);
+
+typedef struct
+{
+    char text[GPS_COMMAND_SIZE];
+    uint8_t length;
+    NovatelCommandCallback callback;
+    void* context;
+}NovatelCommand;
+
+typedef struct
+{
+    UART_HandleTypeDef* UARTInterface;
+
+    uint16_t headerSize;        // D_HDR_LEN or D_SHORT_HDR_LEN, from the last sync
     uint16_t messageSize;
 
-    uint32_t status;
+    uint32_t status;            // Receiver status of the last long header
+
+    // Framer state, kept between calls so frames may span several byte spans
+    uint8_t s;
+    uint16_t b, bb;
+    uint16_t msg_id, msg_len, t_week;
+    uint32_t t_ms;
+    uint32_t crc, crc_from_packet;
+    uint8_t store;              // Payload written to frameData and delivered:
+                                // subscribed (or a catch-all set) and it fits
+    uint8_t recovering;         // Current frame was found by a rescan
+    uint64_t frameTime;
+
+    // Local UART rate, to date bytes back from the end of a span
+    uint32_t lineRate;
+    uint32_t byteTimeNs;
 
-    uint8_t headerData[D_HDR_LEN];
-    uint8_t messageData[GPS_PACKET_SIZE];
+    uint32_t frameCount;
+
+    // Rejected frames are rescanned for a sync inside their own bytes
+    uint32_t bytesDiscarded;
+    uint32_t framesRecovered;
+
+    // UART errors (HAL_UART_ERROR_x of the last one), each breaks the frame
+    // in progress
+    uint32_t lineError;
+    uint32_t lineErrors;
+
+    // Message id -> decoder, looked up once per frame when the id arrives.
+    // Payloads without a decoder are skipped, only the CRC advances: a CRC
+    // failure rescans just their header
+    NovatelSubscription subscriptions[GPS_SUBSCRIPTIONS];
+    const NovatelSubscription* subscription;
+
+    // Optional catch-all (raw logging): every frame is stored when set
+    NovatelFrameCallback frameCallback;
+    void* callbackContext;
+
+    // Time transfer, fed from every frame header
+    NovatelTimeCallback timeCallback;
+    void* timeContext;
+
+    // ASCII path, fed with the bytes seen while the binary framer is hunting for sync
+    NMEAParser nmea;
+
+    // Command queue: one command on the line at a time, completed by its
+    // <OK/<ERROR reply or by timeout
+    NovatelCommand commands[GPS_COMMANDS];
+    volatile uint8_t commandHead, commandTail;
+    volatile uint8_t commandState;
+    uint32_t commandTick;
+    uint32_t commandsOk, commandsFailed;
+    char reply[GPS_REPLY_SIZE];
+    uint8_t replyLength;
+    uint32_t replyCount;
+
+    // Baud rate negotiation, holds the command queue while running
+    NovatelBaudCallback setBaudRate;
+    void* baudContext;
+    uint8_t baudState;
+    uint8_t baudIndex;
+    uint32_t baudRate;          // Current link rate, 0 while unknown
+    uint32_t baudTarget;
+    uint32_t baudTick;
+    uint32_t syncEvents;
+    char baudCommand[40];
+
+    // Frame storage: the framer fills frameData[writeFrame] and publishes it
+    // in latestFrame when its CRC matches. readFrame is held by the consumer
+    // (NOVATELGPS_acquireFrame), the framer never writes it nor the latest
+    uint8_t writeFrame;
+    volatile uint8_t latestFrame, readFrame;
+    uint32_t oversizeFrames;
+    NovatelFrame frames[GPS_FRAME_BUFFERS];
+    uint8_t frameData[GPS_FRAME_BUFFERS][GPS_PACKET_SIZE];
 }NovatelGPS;
 
 
 void NOVATELGPS_configDevice(NovatelGPS* gps, UART_HandleTypeDef* interface);
+void NOVATELGPS_setFrameCallback(NovatelGPS* gps, NovatelFrameCallback callback, void* context);
+void NOVATELGPS_setTimeCallback(NovatelGPS* gps, NovatelTimeCallback callback, void* context);
+void NOVATELGPS_setNmeaCallback(NovatelGPS* gps, NMEASentenceCallback callback, void* context);
+int8_t NOVATELGPS_command(NovatelGPS* gps, const char* command, NovatelCommandCallback callback, void* context);
+void NOVATELGPS_txComplete(NovatelGPS* gps);
+void NOVATELGPS_poll(NovatelGPS* gps);
+int8_t NOVATELGPS_negotiateBaudRate(NovatelGPS* gps, uint32_t target, NovatelBaudCallback setBaudRate, void* context);
+int8_t NOVATELGPS_subscribe(NovatelGPS* gps, uint16_t messageId, NovatelFrameCallback callback, void* context);
+void NOVATELGPS_pushBytes(NovatelGPS* gps, const uint8_t* buffer, uint32_t length);
+void NOVATELGPS_pushBytesAt(NovatelGPS* gps, const uint8_t* buffer, uint32_t length, uint64_t lastByteTime);
+void NOVATELGPS_lineError(NovatelGPS* gps, uint32_t error);
+const NovatelFrame* NOVATELGPS_acquireFrame(NovatelGPS* gps);
 void NOVATELGPS_geData(NovatelGPS* gps);
+
+#endif /* NOVATEL_GPS_H */
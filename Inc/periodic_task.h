@@ -0,0 +1,62 @@
+/**
+ ******************************************************************************
+ * @file      periodic_task.h
+ * @author    Gabriel F P Araujo
+ * @date      17/10/2026
+ ******************************************************************************
+ *
+ * @attention Copyright (C) 2018
+ * @attention Laboratório de Automação e Robótica (LARA)
+ * @attention Departamento de Engenharia Elétrica (ENE)
+ * @attention Universidade de Brasília (UnB)
+ *
+ *
+ *
+ ******************************************************************************
+ *
+ ** ### Periodic task ###
+ *
+ *  Fixed rate loop on vTaskDelayUntil: wake times are kept on the tick grid
+ *  whatever the loop body takes, so the rate does not drift. The rate has to
+ *  divide the tick rate (1 kHz: 100 Hz, 20 Hz...).
+ *
+ *  Each wake is stamped with the local clock (TIMESTAMP_now):
+ *
+ *  (#) Jitter      Wake to wake interval less the period, worst case and a
+ *                  histogram of its magnitude in power of two bins of us
+ *                  (bin 0 below 16 us, bin 7 from 1024 us)
+ *  (#) Overruns    Bodies that took a whole period or more, their deadline
+ *                  was gone before the wait
+ *  (#) Mean period Over the whole run [ns], the rate actually obtained
+ *
+ *  (#) PERIODIC_init   Rate in Hz, from the task that runs the loop
+ *  (#) PERIODIC_wait   End of each loop, sleeps until the next period
+ */
+
+#ifndef PERIODIC_TASK_H
+#define PERIODIC_TASK_H
+
+#define PERIODIC_BINS       8
+#define PERIODIC_BIN0_US    16
+
+typedef struct
+{
+    uint32_t period;            // [ticks]
+    uint32_t periodUs;
+    uint32_t lastWake;          // [ticks], vTaskDelayUntil reference
+
+    uint64_t firstWakeTime;     // [us]
+    uint64_t wakeTime;
+
+    uint32_t cycles;
+    uint32_t overruns;
+    uint32_t jitterMax;         // [us]
+    uint32_t histogram[PERIODIC_BINS];
+    uint32_t meanPeriod;        // [ns]
+}PeriodicTask;
+
+
+void PERIODIC_init(PeriodicTask* task, uint32_t rateHz);
+void PERIODIC_wait(PeriodicTask* task);
+
+#endif /* PERIODIC_TASK_H */
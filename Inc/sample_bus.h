@@ -0,0 +1,67 @@
+/**
+ ******************************************************************************
+ * @file      sample_bus.h
+ * @author    Gabriel F P Araujo
+ * @date      17/10/2026
+ ******************************************************************************
+ *
+ * @attention Copyright (C) 2018
+ * @attention Laboratório de Automação e Robótica (LARA)
+ * @attention Departamento de Engenharia Elétrica (ENE)
+ * @attention Universidade de Brasília (UnB)
+ *
+ *
+ *
+ ******************************************************************************
+ *
+ ** ### Sample bus ###
+ *
+ *  One topic per sensor: a ring of fixed size samples written by a single
+ *  producer (task or interrupt) and read by any number of subscribers, each
+ *  with its own cursor. The producer never waits for the subscribers, it
+ *  overwrites the oldest sample; a subscriber that falls behind skips to the
+ *  oldest sample still in the ring and counts the ones it lost.
+ *
+ *  A subscriber copies the sample out and checks afterwards that the
+ *  producer did not reach it meanwhile, so no lock is taken on either side.
+ *  Of capacity slots, capacity - 1 can be waiting for a subscriber (the
+ *  next one may be under write).
+ *
+ *  (#) SAMPLEBUS_init       Binds the storage, capacity a power of two
+ *  (#) SAMPLEBUS_publish    Producer, copies one sample in
+ *  (#) SAMPLEBUS_subscribe  Starts a cursor at the next sample published
+ *  (#) SAMPLEBUS_read       Subscriber, copies its next sample out
+ */
+
+#ifndef SAMPLE_BUS_H
+#define SAMPLE_BUS_H
+
+// Declares the samples of one topic
+#define SAMPLEBUS_STORAGE(name, type, capacity) \
+    type name##Data[(capacity)]
+
+typedef struct
+{
+    uint8_t* data;
+    uint16_t size;              // Bytes per sample
+    uint32_t capacity;
+    uint32_t mask;
+
+    // Samples published, free running, the index is count & mask
+    volatile uint32_t head;
+}SampleTopic;
+
+typedef struct
+{
+    SampleTopic* topic;
+    uint32_t cursor;            // Next sample to read
+    uint32_t overruns;          // Samples overwritten before they were read
+}SampleSubscriber;
+
+
+void SAMPLEBUS_init(SampleTopic* topic, void* data, uint16_t size, uint32_t capacity);
+void SAMPLEBUS_publish(SampleTopic* topic, const void* sample);
+void SAMPLEBUS_subscribe(SampleTopic* topic, SampleSubscriber* subscriber);
+int8_t SAMPLEBUS_read(SampleSubscriber* subscriber, void* sample);
+
+#endif /* SAMPLE_BUS_H */
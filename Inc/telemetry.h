@@ -0,0 +1,73 @@
+/**
+ ******************************************************************************
+ * @file      telemetry.h
+ * @author    Gabriel F P Araujo
+ * @date      17/10/2026
+ ******************************************************************************
+ *
+ * @attention Copyright (C) 2018
+ * @attention Laboratório de Automação e Robótica (LARA)
+ * @attention Departamento de Engenharia Elétrica (ENE)
+ * @attention Universidade de Brasília (UnB)
+ *
+ *
+ *
+ ******************************************************************************
+ *
+ ** ### Binary telemetry ###
+ *
+ *  Records of every stream multiplexed in one byte stream (USB CDC). Each
+ *  record is COBS encoded and ends with a 0x00 byte, so a reader joining
+ *  at any point resynchronizes at the next zero. Decoded record, all fields
+ *  little-endian:
+ *
+ *  (#) stream      uint8   TELEMETRY_x below, TELEMETRY_GPS_TIME set when
+ *                          the time is GPS time
+ *  (#) sequence    uint16  Per stream, counts the source samples: a gap
+ *                          is a sample lost anywhere on the way
+ *  (#) time        uint64  Time of the sample [us]: GPS time (from the GPS
+ *                          epoch, gps_clock.h) once the receiver gave one,
+ *                          local time before
+ *  (#) payload     Stream dependent, length given by the record size
+ *  (#) crc         uint32  NovAtel CRC-32 (novatel_crc.h) of all the above
+ *
+ *  Records are collected in a buffer by the telemetry task, which queues it
+ *  for the link when full or at the end of a cycle. tools/telemetry_decode.py
+ *  is the reference decoder.
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+// Streams
+#define TELEMETRY_NANOIMU   1       // int32 channel[12], Q31 (memsense_nanoimu.h)
+#define TELEMETRY_MPU6050   2       // int32 channel[7], Q31 (mpu6050.h)
+#define TELEMETRY_GPS       3       // BESTXYZ solution, 87 bytes (main.c)
+#define TELEMETRY_SCHED     4       // uint8 task, uint32 cycles, overruns,
+                                    // jitterMax, meanPeriod, histogram[8]
+#define TELEMETRY_GPS_TIME  0x80    // Flag in the stream byte
+
+#define TELEMETRY_HEADER        11
+#define TELEMETRY_CRC           4
+#define TELEMETRY_MAX_PAYLOAD   128
+
+// Encoded size of a record, delimiter included (COBS adds a byte per 254)
+#define TELEMETRY_RECORD_SIZE(payload) \
+    (TELEMETRY_HEADER + (payload) + TELEMETRY_CRC + (TELEMETRY_HEADER + (payload) + TELEMETRY_CRC)/254 + 2)
+
+typedef struct
+{
+    uint8_t* buffer;
+    uint16_t size;
+    uint16_t length;
+
+    uint32_t records;
+}Telemetry;
+
+
+void TELEMETRY_init(Telemetry* telemetry, uint8_t* buffer, uint16_t size);
+uint8_t TELEMETRY_fits(const Telemetry* telemetry, uint16_t payloadLength);
+int8_t TELEMETRY_add(Telemetry* telemetry, uint8_t stream, uint16_t sequence, uint64_t time, const void* payload, uint16_t payloadLength);
+void TELEMETRY_clear(Telemetry* telemetry);
+
+#endif /* TELEMETRY_H */
@@ -0,0 +1,31 @@
+/**
+ ******************************************************************************
+ * @file      timestamp.h
+ * @author    Gabriel F P Araujo
+ * @date      17/10/2026
+ ******************************************************************************
+ *
+ * @attention Copyright (C) 2018
+ * @attention Laboratório de Automação e Robótica (LARA)
+ * @attention Departamento de Engenharia Elétrica (ENE)
+ * @attention Universidade de Brasília (UnB)
+ *
+ *
+ *
+ ******************************************************************************
+ *
+ ** ### Local time base ###
+ *
+ *  Microseconds since TIMESTAMP_init, from the DWT cycle counter extended to
+ *  64 bits. Safe from tasks and interrupts. The counter wraps every 2^32
+ *  cycles (~59 s at 72 MHz), so TIMESTAMP_now must be called at least that
+ *  often (the GPS task does it on every cycle).
+ */
+
+#ifndef TIMESTAMP_H
+#define TIMESTAMP_H
+
+void TIMESTAMP_init(void);
+uint64_t TIMESTAMP_now(void);
+
+#endif /* TIMESTAMP_H */
@@ -0,0 +1,59 @@
+/**
+ ******************************************************************************
+ * @file      uart_dma.h
+ * @author    Gabriel F P Araujo
+ * @date      17/10/2026
+ ******************************************************************************
+ *
+ * @attention Copyright (C) 2018
+ * @attention Laboratório de Automação e Robótica (LARA)
+ * @attention Departamento de Engenharia Elétrica (ENE)
+ * @attention Universidade de Brasília (UnB)
+ *
+ *
+ *
+ ******************************************************************************
+ *
+ ** ### Circular DMA reception ###
+ *
+ *  The UART is received into a circular DMA buffer that is never stopped.
+ *  On half transfer, transfer complete and IDLE line the bytes written since
+ *  the last event are handed to the span callback (at most two spans when
+ *  the buffer wraps). The callback runs in interrupt context.
+ *
+ *  (#) UARTDMA_start         Arms reception, after MX_USARTx_UART_Init
+ *  (#) UARTDMA_irqHandler    USARTx_IRQHandler, before HAL_UART_IRQHandler
+ *  (#) UARTDMA_rxEvent       HAL_UART_RxHalfCpltCallback/HAL_UART_RxCpltCallback
+ *  (#) UARTDMA_restart       HAL_UART_ErrorCallback (HAL aborts the DMA on errors)
+ *  (#) UARTDMA_setBaudRate   Task context, with no transmission in progress
+ */
+
+#ifndef UART_DMA_H
+#define UART_DMA_H
+
+typedef void (*UARTDMASpanCallback)(const uint8_t* data, uint16_t length, void* context);
+
+typedef struct
+{
+    UART_HandleTypeDef* UARTInterface;
+
+    uint8_t* buffer;
+    uint16_t bufferSize;
+
+    // Next buffer position not yet handed to the callback
+    uint16_t tail;
+
+    uint32_t restarts;
+
+    UARTDMASpanCallback spanCallback;
+    void* callbackContext;
+}UARTDMARx;
+
+
+void UARTDMA_start(UARTDMARx* rx, UART_HandleTypeDef* interface, uint8_t* buffer, uint16_t size, UARTDMASpanCallback callback, void* context);
+void UARTDMA_irqHandler(UARTDMARx* rx);
+void UARTDMA_rxEvent(UARTDMARx* rx);
+void UARTDMA_restart(UARTDMARx* rx);
+void UARTDMA_setBaudRate(UARTDMARx* rx, uint32_t baudRate);
+
+#endif /* UART_DMA_H */
@@ -134,6 +134,8 @@ extern USBD_CDC_ItfTypeDef USBD_Interface_fops_FS;
 uint8_t CDC_Transmit_FS(uint8_t* Buf, uint16_t Len);
 
 /* USER CODE BEGIN EXPORTED_FUNCTIONS */
+uint16_t CDC_TxFree_FS(void);
+uint32_t CDC_TxRefused_FS(void);
 
 /* USER CODE END EXPORTED_FUNCTIONS */
 
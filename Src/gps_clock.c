@@ -0,0 +1,196 @@
+/**
+ ******************************************************************************
+ * @file      gps_clock.c
+ * @author    Gabriel F P Araujo
+ * @date      17/10/2026
+ ******************************************************************************
+ *
+ * @attention Copyright (C) 2018
+ * @attention Laboratório de Automação e Robótica (LARA)
+ * @attention Departamento de Engenharia Elétrica (ENE)
+ * @attention Universidade de Brasília (UnB)
+ */
+
+#include <string.h>
+#include "stm32f1xx_hal.h"
+#include "gps_clock.h"
+
+#define SECOND_US       1000000ULL
+
+static void GPSCLOCK_update(GPSClock* clock, uint64_t gps, uint64_t local, int32_t gate);
+static void GPSCLOCK_step(GPSClock* clock, uint64_t gps, uint64_t local);
+static int64_t GPSCLOCK_offsetAt(const GPSClock* clock, uint64_t local);
+
+void GPSCLOCK_init(GPSClock* clock)
+{
+    memset(clock, 0, sizeof(GPSClock));
+}
+
+void GPSCLOCK_pps(GPSClock* clock, uint64_t local)
+{
+    // Which second this edge starts is only known from the next frame
+    clock->ppsLocal = local;
+    clock->ppsPending = 1;
+}
+
+void GPSCLOCK_frame(GPSClock* clock, uint16_t week, uint32_t milliseconds, uint64_t local)
+{
+    uint64_t gps;
+
+    // No time solution yet, or the frame was not stamped
+    if((week == 0) || (local == 0))
+        return;
+
+    gps = (uint64_t)week*GPS_WEEK_US + (uint64_t)milliseconds*1000;
+
+    if(clock->ppsPending)
+    {
+        uint64_t elapsed = local - clock->ppsLocal;
+
+        clock->ppsPending = 0;
+
+        // GPS time at the edge: frame time minus the local time since the
+        // edge, rounded to the second (latency only has to stay under 0.5 s)
+        if((elapsed < SECOND_US) && (gps > elapsed))
+        {
+            uint64_t second = ((gps - elapsed + SECOND_US/2) / SECOND_US) * SECOND_US;
+
+            GPSCLOCK_update(clock, second, clock->ppsLocal, GPSCLOCK_PPS_GATE_US);
+            clock->ppsUpdate = local;
+            return;
+        }
+    }
+
+    // Frames carry the output latency, mixing them with edges would bias the offset
+    if((clock->ppsUpdate != 0) && ((local - clock->ppsUpdate) < GPSCLOCK_PPS_TIMEOUT_US))
+    {
+        clock->windowStart = 0;
+        return;
+    }
+
+    // Latency only adds, so the largest gps - local of the window is the
+    // least delayed frame. Compared relative to the window's best so far
+    if((clock->windowStart == 0) || ((int64_t)((gps - clock->windowGps) - (local - clock->windowLocal)) > 0))
+    {
+        clock->windowGps = gps;
+        clock->windowLocal = local;
+    }
+
+    if(clock->windowStart == 0)
+    {
+        clock->windowStart = local;
+    }
+    else if((local - clock->windowStart) >= GPSCLOCK_WINDOW_US)
+    {
+        GPSCLOCK_update(clock, clock->windowGps, clock->windowLocal, GPSCLOCK_FRAME_GATE_US);
+        clock->windowStart = 0;
+    }
+}
+
+uint64_t GPSCLOCK_gpsTimeFromLocal(GPSClock* clock, uint64_t local)
+{
+    int64_t offset;
+    uint32_t updates;
+
+    // Model is updated from the GPS interrupt, read it in one piece
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    offset = GPSCLOCK_offsetAt(clock, local);
+    updates = clock->updates;
+
+    __set_PRIMASK(primask);
+
+    // 0 until the first measurement, and for samples that were not stamped
+    if((updates == 0) || (local == 0))
+        return 0;
+
+    return local + offset;
+}
+
+static void GPSCLOCK_update(GPSClock* clock, uint64_t gps, uint64_t local, int32_t gate)
+{
+    int64_t predicted, residual, elapsed;
+    int64_t drift;
+    int32_t offsetGain = GPSCLOCK_OFFSET_GAIN;
+    int32_t driftGain = GPSCLOCK_DRIFT_GAIN;
+    uint32_t primask;
+
+    if(clock->updates == 0)
+    {
+        GPSCLOCK_step(clock, gps, local);
+        return;
+    }
+
+    predicted = GPSCLOCK_offsetAt(clock, local);
+    residual = (int64_t)(gps - local) - predicted;
+    elapsed = (int64_t)(local - clock->reference);
+
+    // Acquisition pulls in the drift quickly, with a wider gate
+    if(!clock->locked)
+    {
+        offsetGain = GPSCLOCK_ACQUIRE_OFFSET_GAIN;
+        driftGain = GPSCLOCK_ACQUIRE_DRIFT_GAIN;
+        gate *= GPSCLOCK_ACQUIRE_GATE;
+    }
+
+    if((residual > gate) || (residual < -gate) || (elapsed <= 0))
+    {
+        clock->outliers++;
+        clock->outlierRun++;
+
+        // Consistently off: the receiver or the local clock jumped
+        if(clock->outlierRun >= GPSCLOCK_MAX_OUTLIERS)
+            GPSCLOCK_step(clock, gps, local);
+        return;
+    }
+
+    // Drift follows the residual rate, Q32 (residual < gate, no overflow)
+    drift = clock->drift + ((residual * 4294967296LL) / elapsed) / driftGain;
+    if(drift > GPSCLOCK_MAX_DRIFT)
+        drift = GPSCLOCK_MAX_DRIFT;
+    if(drift < -GPSCLOCK_MAX_DRIFT)
+        drift = -GPSCLOCK_MAX_DRIFT;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+
+    clock->offset = predicted + residual / offsetGain;
+    clock->drift = (int32_t) drift;
+    clock->reference = local;
+
+    __set_PRIMASK(primask);
+
+    clock->residual = (int32_t) residual;
+    clock->outlierRun = 0;
+    clock->updates++;
+    if(clock->updates >= GPSCLOCK_LOCK_UPDATES)
+        clock->locked = 1;
+}
+
+static void GPSCLOCK_step(GPSClock* clock, uint64_t gps, uint64_t local)
+{
+    // Take the measurement as is and start the estimate over, drift is kept
+    // (it belongs to the local oscillator)
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    clock->offset = (int64_t)(gps - local);
+    clock->reference = local;
+
+    __set_PRIMASK(primask);
+
+    clock->residual = 0;
+    clock->outlierRun = 0;
+    clock->locked = 0;
+    clock->updates = 1;
+    clock->steps++;
+}
+
+static int64_t GPSCLOCK_offsetAt(const GPSClock* clock, uint64_t local)
+{
+    int64_t elapsed = (int64_t)(local - clock->reference);
+
+    // Q32 drift: elapsed up to minutes stays well inside 64 bits
+    return clock->offset + ((elapsed * clock->drift) >> 32);
+}
@@ -0,0 +1,82 @@
+/**
+ ******************************************************************************
+ * @file      imu_ring.c
+ * @author    Gabriel F P Araujo
+ * @date      17/10/2026
+ ******************************************************************************
+ *
+ * @attention Copyright (C) 2018
+ * @attention Laboratório de Automação e Robótica (LARA)
+ * @attention Departamento de Engenharia Elétrica (ENE)
+ * @attention Universidade de Brasília (UnB)
+ */
+
+#include "stm32f1xx_hal.h"
+#include "imu_ring.h"
+
+void IMURING_init(IMURing* ring, int32_t* data, uint64_t* time, uint8_t channels, uint32_t capacity)
+{
+    // Free running counts only index correctly with a power of two
+    if((capacity == 0) || ((capacity & (capacity - 1)) != 0))
+    {
+        Error_Handler();
+    }
+
+    ring->data = data;
+    ring->time = time;
+    ring->channels = channels;
+    ring->capacity = capacity;
+    ring->mask = capacity - 1;
+    ring->head = 0;
+    ring->tail = 0;
+    ring->overruns = 0;
+}
+
+int8_t IMURING_push(IMURing* ring, const int32_t* channel, uint64_t time)
+{
+    uint32_t head = ring->head;
+    uint32_t index = head & ring->mask;
+    int32_t* data = &ring->data[index];
+
+    // The consumer may be reading the oldest samples, the new one is dropped
+    if(head - ring->tail >= ring->capacity)
+    {
+        ring->overruns++;
+        return 0;
+    }
+
+    for(uint8_t c = 0; c < ring->channels; c++, data += ring->capacity)
+        *data = channel[c];
+    ring->time[index] = time;
+
+    // Published last: the consumer never sees a half written sample
+    ring->head = head + 1;
+
+    return 1;
+}
+
+uint32_t IMURING_peek(IMURing* ring, uint32_t maxSamples, uint32_t* offset)
+{
+    uint32_t tail = ring->tail;
+    uint32_t samples = ring->head - tail;
+    uint32_t index = tail & ring->mask;
+
+    // Up to the end of the arrays, the rest comes in the next run
+    if(samples > ring->capacity - index)
+        samples = ring->capacity - index;
+    if(samples > maxSamples)
+        samples = maxSamples;
+
+    *offset = index;
+    return samples;
+}
+
+const int32_t* IMURING_channel(const IMURing* ring, uint8_t channel)
+{
+    return &ring->data[channel*ring->capacity];
+}
+
+void IMURING_release(IMURing* ring, uint32_t samples)
+{
+    ring->tail += samples;
+}
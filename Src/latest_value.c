@@ -0,0 +1,57 @@
+/**
+ ******************************************************************************
+ * @file      latest_value.c
+ * @author    Gabriel F P Araujo
+ * @date      17/10/2026
+ ******************************************************************************
+ *
+ * @attention Copyright (C) 2018
+ * @attention Laboratório de Automação e Robótica (LARA)
+ * @attention Departamento de Engenharia Elétrica (ENE)
+ * @attention Universidade de Brasília (UnB)
+ */
+
+#include <string.h>
+#include "stm32f1xx_hal.h"
+#include "latest_value.h"
+
+void LATESTVALUE_init(LatestValue* value, void* data, uint16_t size)
+{
+    value->data = (uint8_t*) data;
+    value->size = size;
+    value->sequence = 0;
+}
+
+void LATESTVALUE_write(LatestValue* value, const void* sample)
+{
+    uint32_t sequence = value->sequence;
+
+    // Odd: readers copying now will start over
+    value->sequence = sequence + 1;
+    __DMB();
+    memcpy(value->data, sample, value->size);
+    __DMB();
+    value->sequence = sequence + 2;
+}
+
+int8_t LATESTVALUE_read(const LatestValue* value, void* sample)
+{
+    uint32_t sequence;
+
+    do
+    {
+        sequence = value->sequence;
+
+        // Never written
+        if(sequence == 0)
+            return 0;
+
+        __DMB();
+        memcpy(sample, value->data, value->size);
+        __DMB();
+
+        // A write started or finished during the copy, it may be torn
+    }while((sequence & 1) || (value->sequence != sequence));
+
+    return 1;
+}
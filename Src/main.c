@@ -56,6 +56,16 @@
 #include "mpu6050.h"
 #include "memsense_nanoimu.h"
 #include "novatel_gps.h"
+#include "novatel_bestxyz.h"
+#include "uart_dma.h"
+#include "timestamp.h"
+#include "gps_clock.h"
+#include "imu_ring.h"
+#include "sample_bus.h"
+#include "latest_value.h"
+#include "periodic_task.h"
+#include "telemetry.h"
+#include "usbd_cdc_if.h"
 /* USER CODE END Includes */
 
 /* Private variables ---------------------------------------------------------*/
@@ -64,6 +74,8 @@ I2C_HandleTypeDef hi2c1;
 UART_HandleTypeDef huart1;
 UART_HandleTypeDef huart2;
 UART_HandleTypeDef huart3;
+DMA_HandleTypeDef hdma_usart1_rx;
+DMA_HandleTypeDef hdma_usart2_rx;
 
 osThreadId defaultTaskHandle;
 osThreadId imuComTaskHandle;
@@ -80,32 +92,106 @@ typedef struct
 
 Error error;
 
-/* UART status declaration */
-__IO ITStatus Uart1Ready = RESET;
-__IO ITStatus Uart2Ready = RESET;
-__IO ITStatus Uart3Ready = RESET;
 
-/* Imu MPU6050 */
+/* Imu MPU6050, 1 kHz (188 Hz low pass) through its FIFO, drained every 8 samples */
+#define MPU6050_BATCH      8
 MPU6050Imu imu6050;
 /* Novatel GPS OEMV-1 */
 NovatelGPS novatelGps;
+/* GPS time of the local clock, fed by the GPS frames */
+GPSClock gpsClock;
 /* MemSense NanoImu */
 MEMSenseImu nanoImu;
 int counter;
-#define BXYZ_PSTAT    (D_HDR_LEN)
-#define BXYZ_PTYPE    (D_HDR_LEN+4)
-#define BXYZ_PX     (D_HDR_LEN+8)
-#define BXYZ_PY     (D_HDR_LEN+16)
-#define BXYZ_PZ     (D_HDR_LEN+24)
-#define BXYZ_sPX    (D_HDR_LEN+32)
-#define BXYZ_sPY    (D_HDR_LEN+36)
-#define BXYZ_sPZ    (D_HDR_LEN+40)
+
+/* NanoIMU history, 32 samples (~0.2 s at 150 Hz, 1.8 KB), consumed in batches */
+#define NANOIMU_RING_SIZE  32
+#define NANOIMU_BATCH      8
+IMURING_STORAGE(nanoImuRing, NANOIMU_CHANNELS, NANOIMU_RING_SIZE);
+IMURing nanoImuRing;
+/* Average of the last batch */
+MEMSenseSample nanoImuMean;
+
+/* MPU6050 history, 32 samples (32 ms at 1 kHz, 1.1 KB), consumed in batches */
+#define MPU6050_RING_SIZE  32
+IMURING_STORAGE(mpu6050Ring, MPU6050_CHANNELS, MPU6050_RING_SIZE);
+IMURing mpu6050Ring;
+/* Average of the last batch */
+MPU6050Sample mpu6050Mean;
+
+/* Sample bus: every sensor sample, for the consumers that read at their own
+   pace (telemetry, logging). Published from the sensor interrupts */
+#define NANOIMU_TOPIC_SIZE  16
+#define MPU6050_TOPIC_SIZE  16
+#define GPS_TOPIC_SIZE      4
+SAMPLEBUS_STORAGE(nanoImuTopic, MEMSenseSample, NANOIMU_TOPIC_SIZE);
+SAMPLEBUS_STORAGE(mpu6050Topic, MPU6050Sample, MPU6050_TOPIC_SIZE);
+SAMPLEBUS_STORAGE(gpsTopic, BestxyzSample, GPS_TOPIC_SIZE);
+SampleTopic nanoImuTopic;
+SampleTopic mpu6050Topic;
+SampleTopic gpsTopic;
+
+/* Newest sample of each sensor, for readers that only want the current value */
+LATESTVALUE_STORAGE(nanoImuLatest, MEMSenseSample);
+LATESTVALUE_STORAGE(mpu6050Latest, MPU6050Sample);
+LATESTVALUE_STORAGE(gpsLatest, BestxyzSample);
+LatestValue nanoImuLatest;
+LatestValue mpu6050Latest;
+LatestValue gpsLatest;
+
+/* Fixed rate tasks, their jitter and overruns go out in the telemetry */
+#define TELEMETRY_RATE_HZ  100
+#define GPS_TASK_RATE_HZ   20
+PeriodicTask telemetryPeriod;
+PeriodicTask gpsPeriod;
+
+/* Binary telemetry, every sample of the bus plus status once a second. The
+   buffer stages records for the USB transmit queue (usbd_cdc_if.c) */
+#define TELEMETRY_BUFFER_SIZE  256
+#define TELEMETRY_STATUS       5    /* uint8 valid, uint64 newest time of NanoIMU, MPU6050
+                                       and GPS, uint32 overruns of the three subscribers,
+                                       writes refused by the USB queue, MPU6050 FIFO overflows,
+                                       NanoIMU packets dropped, uint8 error flag, uint32 error
+                                       line, char[16] error file name */
+#define STATUS_FILE_SIZE       16
+#define GPS_RECORD_SIZE        87
+#define SCHED_TELEMETRY        0
+#define SCHED_GPS              1
+Telemetry telemetry;
+/* Telemetry cursors on the sample bus */
+SampleSubscriber nanoImuSubscriber;
+SampleSubscriber mpu6050Subscriber;
+SampleSubscriber gpsSubscriber;
+
+/* Coherent per sensor, read by the default task */
+typedef struct
+{
+  MEMSenseSample nanoImu;
+  MPU6050Sample mpu6050;
+  BestxyzSample gps;
+  uint8_t valid;              /* One bit per sensor read, NanoIMU, MPU6050, GPS */
+}SensorSnapshot;
+
+/* Circular DMA reception of the sensor UARTs */
+#define UART1_RX_BUFFER_SIZE  256
+#define UART2_RX_BUFFER_SIZE  512
+uint8_t uart1RxBuffer[UART1_RX_BUFFER_SIZE];
+uint8_t uart2RxBuffer[UART2_RX_BUFFER_SIZE];
+UARTDMARx uart1Rx;
+UARTDMARx uart2Rx;
+
+/* GPS link rate requested at bring-up (USART2 starts at 115200) */
+#define GPS_BPS  460800
+
+/* BESTXYZB frames received, the payload is read from NOVATELGPS_acquireFrame */
+__IO uint32_t gpsBestxyzCount = 0;
 
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
 void SystemClock_Config(void);
 static void MX_GPIO_Init(void);
+static void MX_DMA_Init(void);
 static void MX_I2C1_Init(void);
 static void MX_USART1_UART_Init(void);
 static void MX_USART2_UART_Init(void);
@@ -116,6 +202,24 @@ void StartDefaultTask(void const * argument);
 /* Private function prototypes -----------------------------------------------*/
 void ImuComTask(void const * argument);
 void GpsComTask(void const * argument);
+static void NanoImuSpanCallback(const uint8_t* data, uint16_t length, void* context);
+static void NanoImuPacketCallback(const MEMSenseSample* sample, void* context);
+static void Mpu6050ReadCallback(MPU6050Imu* imu, void* context);
+static void ImuRingMean(IMURing* ring, uint32_t batch, int32_t* mean);
+static void NotifyTaskFromISR(osThreadId task);
+static void SensorSnapshotRead(SensorSnapshot* snapshot);
+static uint16_t GpsRecord(const BestxyzSample* sample, uint8_t* record);
+static uint16_t SchedRecord(uint8_t task, const PeriodicTask* periodic, uint8_t* record);
+static uint16_t StatusRecord(const SensorSnapshot* snapshot, uint8_t* record);
+static uint8_t* RecordPut(uint8_t* record, const void* field, uint16_t size);
+static uint8_t TelemetryRoom(uint16_t payloadLength);
+static uint8_t TelemetryFlush(void);
+static void TelemetryAddSample(uint8_t stream, uint16_t sequence, uint64_t localTime, const void* payload,
+                               uint16_t length);
+static void NovatelGpsSpanCallback(const uint8_t* data, uint16_t length, void* context);
+static void NovatelGpsBestxyzCallback(const NovatelFrame* frame, void* context);
+static void NovatelGpsTimeCallback(uint16_t week, uint32_t milliseconds, uint64_t localTime, void* context);
+static void NovatelGpsBaudCallback(uint32_t baudRate, void* context);
 
 /* USER CODE END PFP */
 
@@ -152,17 +256,44 @@ int main(void)
 
   /* Initialize all configured peripherals */
   MX_GPIO_Init();
+  MX_DMA_Init();
   MX_I2C1_Init();
   MX_USART1_UART_Init();
   MX_USART2_UART_Init();
   MX_USART3_UART_Init();
   /* USER CODE BEGIN 2 */
 
-  MPU6050_configDevice(&imu6050, &hi2c1, 0, 0);
+  TIMESTAMP_init();
+  GPSCLOCK_init(&gpsClock);
+  SAMPLEBUS_init(&nanoImuTopic, nanoImuTopicData, sizeof(MEMSenseSample), NANOIMU_TOPIC_SIZE);
+  SAMPLEBUS_init(&mpu6050Topic, mpu6050TopicData, sizeof(MPU6050Sample), MPU6050_TOPIC_SIZE);
+  SAMPLEBUS_init(&gpsTopic, gpsTopicData, sizeof(BestxyzSample), GPS_TOPIC_SIZE);
+  LATESTVALUE_init(&nanoImuLatest, &nanoImuLatestData, sizeof(MEMSenseSample));
+  LATESTVALUE_init(&mpu6050Latest, &mpu6050LatestData, sizeof(MPU6050Sample));
+  LATESTVALUE_init(&gpsLatest, &gpsLatestData, sizeof(BestxyzSample));
+
+  MPU6050_configDevice(&imu6050, &hi2c1, MPU6050_ACCEL_4G, MPU6050_GYRO_500DPS, MPU6050_DLPF_188HZ, 0);
+  MPU6050_configFifo(&imu6050, MPU6050_BATCH);
+  IMURING_init(&mpu6050Ring, mpu6050RingData, mpu6050RingTime, MPU6050_CHANNELS, MPU6050_RING_SIZE);
+  MPU6050_setReadCallback(&imu6050, Mpu6050ReadCallback, &mpu6050Ring);
   NANOIMU_configDevice(&nanoImu, &huart1);
+  IMURING_init(&nanoImuRing, nanoImuRingData, nanoImuRingTime, NANOIMU_CHANNELS, NANOIMU_RING_SIZE);
+  NANOIMU_setPacketCallback(&nanoImu, NanoImuPacketCallback, &nanoImuRing);
   NOVATELGPS_configDevice(&novatelGps, &huart2);
+  NOVATELGPS_subscribe(&novatelGps, BESTXYZ, NovatelGpsBestxyzCallback, NULL);
+  NOVATELGPS_setTimeCallback(&novatelGps, NovatelGpsTimeCallback, &gpsClock);
   counter = 0;
 
+  /* MPU6050 bursts are started from its data ready interrupt */
+  MPU6050_start(&imu6050);
+
+  /* Sensor bytes are handed to the parsers from the DMA/IDLE interrupts */
+  UARTDMA_start(&uart1Rx, &huart1, uart1RxBuffer, UART1_RX_BUFFER_SIZE, NanoImuSpanCallback, &nanoImu);
+  UARTDMA_start(&uart2Rx, &huart2, uart2RxBuffer, UART2_RX_BUFFER_SIZE, NovatelGpsSpanCallback, &novatelGps);
+
+  /* Find the receiver's rate and raise it, runs from the GPS task before the queued commands */
+  NOVATELGPS_negotiateBaudRate(&novatelGps, GPS_BPS, NovatelGpsBaudCallback, &uart2Rx);
+
   /*Init error flag*/
   error.flag = 0;
   error.file[0] = '\0';
@@ -282,7 +413,7 @@ static void MX_I2C1_Init(void)
 {
 
   hi2c1.Instance = I2C1;
-  hi2c1.Init.ClockSpeed = 100000;
+  hi2c1.Init.ClockSpeed = 400000;
   hi2c1.Init.DutyCycle = I2C_DUTYCYCLE_2;
   hi2c1.Init.OwnAddress1 = 0;
   hi2c1.Init.AddressingMode = I2C_ADDRESSINGMODE_7BIT;
@@ -354,6 +485,24 @@ static void MX_USART3_UART_Init(void)
 
 }
 
+/** 
+  * Enable DMA controller clock
+  */
+static void MX_DMA_Init(void) 
+{
+  /* DMA controller clock enable */
+  __HAL_RCC_DMA1_CLK_ENABLE();
+
+  /* DMA interrupt init */
+  /* DMA1_Channel5_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(DMA1_Channel5_IRQn, 5, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Channel5_IRQn);
+  /* DMA1_Channel6_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(DMA1_Channel6_IRQn, 5, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Channel6_IRQn);
+
+}
+
 /** Configure pins as 
         * Analog 
         * Input 
@@ -388,13 +537,23 @@ static void MX_GPIO_Init(void)
 
   /*Configure GPIO pins : PB0 PB1 PB2 PB12 
                            PB13 PB14 PB15 PB3 
-                           PB4 PB5 PB8 PB9 */
+                           PB4 PB8 PB9 */
   GPIO_InitStruct.Pin = GPIO_PIN_0|GPIO_PIN_1|GPIO_PIN_2|GPIO_PIN_12 
                           |GPIO_PIN_13|GPIO_PIN_14|GPIO_PIN_15|GPIO_PIN_3 
-                          |GPIO_PIN_4|GPIO_PIN_5|GPIO_PIN_8|GPIO_PIN_9;
+                          |GPIO_PIN_4|GPIO_PIN_8|GPIO_PIN_9;
   GPIO_InitStruct.Mode = GPIO_MODE_ANALOG;
   HAL_GPIO_Init(GPIOB, &GPIO_InitStruct);
 
+  /*Configure GPIO pin : MPU_INT_Pin */
+  GPIO_InitStruct.Pin = MPU_INT_Pin;
+  GPIO_InitStruct.Mode = GPIO_MODE_IT_RISING;
+  GPIO_InitStruct.Pull = GPIO_PULLDOWN;
+  HAL_GPIO_Init(MPU_INT_GPIO_Port, &GPIO_InitStruct);
+
+  /* EXTI interrupt init*/
+  HAL_NVIC_SetPriority(EXTI9_5_IRQn, 5, 0);
+  HAL_NVIC_EnableIRQ(EXTI9_5_IRQn);
+
 }
 
 /* USER CODE BEGIN 4 */
@@ -408,20 +567,15 @@ static void MX_GPIO_Init(void)
   */
 void HAL_UART_TxCpltCallback(UART_HandleTypeDef *UartHandle)
 {
-  /* Set transmission flag: transfer complete */
+  /* Transfer complete: wake the task that owns the UART */
   if (UartHandle->Instance == USART1)
   {
-    Uart1Ready = SET;
+    NotifyTaskFromISR(imuComTaskHandle);
   }
 
   if (UartHandle->Instance == USART2)
   {
-    Uart2Ready = SET;
-  }
-
-  if (UartHandle->Instance == USART3)
-  {
-    Uart3Ready = SET;
+    NOVATELGPS_txComplete(&novatelGps);
   }
 
 }
@@ -435,22 +589,36 @@ void HAL_UART_TxCpltCallback(UART_HandleTypeDef *UartHandle)
   */
 void HAL_UART_RxCpltCallback(UART_HandleTypeDef *UartHandle)
 {
-  /* Set transmission flag: transfer complete */
+  /* Circular DMA wrapped: hand the end of the buffer to the parsers */
   if (UartHandle->Instance == USART1)
   {
-    Uart1Ready = SET;
+    UARTDMA_rxEvent(&uart1Rx);
   }
 
   if (UartHandle->Instance == USART2)
   {
-    Uart2Ready = SET;
+    UARTDMA_rxEvent(&uart2Rx);
   }
 
-  if (UartHandle->Instance == USART3)
+}
+
+/**
+  * @brief  Rx Half Transfer completed callback
+  * @param  UartHandle: UART handle
+  * @note   Circular DMA is half full: hand the new bytes to the parsers
+  * @retval None
+  */
+void HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef *UartHandle)
+{
+  if (UartHandle->Instance == USART1)
   {
-    Uart3Ready = SET;
+    UARTDMA_rxEvent(&uart1Rx);
   }
 
+  if (UartHandle->Instance == USART2)
+  {
+    UARTDMA_rxEvent(&uart2Rx);
+  }
 }
 
 /**
@@ -464,14 +632,15 @@ void HAL_UART_ErrorCallback(UART_HandleTypeDef *UartHandle)
 {
   if (UartHandle->Instance == USART1)
   {
-    nanoImu.status = HAL_UART_GetError(UartHandle);
-    Uart1Ready = SET;
+    NANOIMU_lineError(&nanoImu, HAL_UART_GetError(UartHandle));
+    UARTDMA_restart(&uart1Rx);
+    NotifyTaskFromISR(imuComTaskHandle);
   }
 
   if (UartHandle->Instance == USART2)
   {
-    novatelGps.status = HAL_UART_GetError(UartHandle);
-    Uart2Ready = SET;
+    NOVATELGPS_lineError(&novatelGps, HAL_UART_GetError(UartHandle));
+    UARTDMA_restart(&uart2Rx);
   }
 
   if (UartHandle->Instance == USART3)
@@ -489,25 +658,374 @@ void ImuComTask(void const * argument)
 {
   for(;;)
   {
-    volatile uint8_t *nano_data = nanoImu.data;
-    volatile uint8_t *mpu_data = imu6050.lastData;
+    /* Blocked until either sensor interrupt has new samples, notifications
+       given meanwhile are taken at once */
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
 
-    if(HAL_UART_Receive_IT(nanoImu.UARTInterface, nanoImu.data, IMU_PACKET_SIZE) != HAL_OK)
-    {
-      Error_Handler();
-    }
+    ImuRingMean(&nanoImuRing, NANOIMU_BATCH, nanoImuMean.channel);
+    ImuRingMean(&mpu6050Ring, MPU6050_BATCH, mpu6050Mean.channel);
+
+    counter++;
+  }
+}
 
-    while (Uart1Ready != SET)
+/**
+  * @brief  Averages the whole batches waiting in a sample ring
+  * @param  ring: Sample ring
+  * @param  batch: Samples per batch, divides the ring capacity
+  * @param  mean: Average of the last batch, one per channel
+  * @retval None
+  */
+static void ImuRingMean(IMURing* ring, uint32_t batch, int32_t* mean)
+{
+  /* Whole batches only, each channel is a contiguous run of the ring */
+  uint32_t offset;
+  while (IMURING_peek(ring, batch, &offset) == batch)
+  {
+    for (uint8_t c = 0; c < ring->channels; c++)
     {
+      const int32_t* x = IMURING_channel(ring, c) + offset;
+      int64_t sum = 0;
+
+      for (uint32_t i = 0; i < batch; i++)
+        sum += x[i];
+      mean[c] = (int32_t)(sum / batch);
     }
+    IMURING_release(ring, batch);
+  }
+}
 
-    Uart1Ready = RESET;
+/**
+  * @brief  Newest sample of every sensor
+  * @param  snapshot: Samples, valid tells which sensors have one yet
+  * @retval None
+  */
+static void SensorSnapshotRead(SensorSnapshot* snapshot)
+{
+  /* No interrupt masking: a read only repeats its copy if hit by a write */
+  snapshot->valid = LATESTVALUE_read(&nanoImuLatest, &snapshot->nanoImu);
+  snapshot->valid |= LATESTVALUE_read(&mpu6050Latest, &snapshot->mpu6050) << 1;
+  snapshot->valid |= LATESTVALUE_read(&gpsLatest, &snapshot->gps) << 2;
+}
 
-    MPU6050_geData(&imu6050);
-    counter++;
+/**
+  * @brief  Telemetry payload of a BESTXYZ solution
+  * @param  sample: Solution
+  * @param  record: Payload, 87 bytes
+  * @retval Payload length
+  * @note   week, milliseconds, positionStatus, solutionSatellites, position[3],
+  *         positionSigma[3], velocityStatus, velocity[3], velocitySigma[3]
+  */
+static uint16_t GpsRecord(const BestxyzSample* sample, uint8_t* record)
+{
+  uint8_t* p = record;
+
+  /* Field by field, the struct has padding */
+  p = RecordPut(p, &sample->week, 2);
+  p = RecordPut(p, &sample->milliseconds, 4);
+  p = RecordPut(p, &sample->positionStatus, 4);
+  p = RecordPut(p, &sample->solutionSatellites, 1);
+  p = RecordPut(p, sample->position, sizeof(sample->position));
+  p = RecordPut(p, sample->positionSigma, sizeof(sample->positionSigma));
+  p = RecordPut(p, &sample->velocityStatus, 4);
+  p = RecordPut(p, sample->velocity, sizeof(sample->velocity));
+  p = RecordPut(p, sample->velocitySigma, sizeof(sample->velocitySigma));
+
+  return (uint16_t)(p - record);
+}
+
+/**
+  * @brief  Telemetry payload of the scheduling statistics of a fixed rate task
+  * @param  task: SCHED_x
+  * @param  periodic: Periodic task
+  * @param  record: Payload, 49 bytes
+  * @retval Payload length
+  */
+static uint16_t SchedRecord(uint8_t task, const PeriodicTask* periodic, uint8_t* record)
+{
+  uint8_t* p = record;
+
+  p = RecordPut(p, &task, 1);
+  p = RecordPut(p, &periodic->cycles, 4);
+  p = RecordPut(p, &periodic->overruns, 4);
+  p = RecordPut(p, &periodic->jitterMax, 4);
+  p = RecordPut(p, &periodic->meanPeriod, 4);
+  p = RecordPut(p, periodic->histogram, sizeof(periodic->histogram));
+
+  return (uint16_t)(p - record);
+}
+
+/**
+  * @brief  Telemetry payload of the link status
+  * @param  snapshot: Newest sample of each sensor
+  * @param  record: Payload, 70 bytes
+  * @retval Payload length
+  */
+static uint16_t StatusRecord(const SensorSnapshot* snapshot, uint8_t* record)
+{
+  uint8_t* p = record;
+  uint32_t refused = CDC_TxRefused_FS();
+  const char* file = strrchr(error.file, '/');
+
+  p = RecordPut(p, &snapshot->valid, 1);
+  p = RecordPut(p, &snapshot->nanoImu.time, 8);
+  p = RecordPut(p, &snapshot->mpu6050.time, 8);
+  p = RecordPut(p, &snapshot->gps.localTime, 8);
+  p = RecordPut(p, &nanoImuSubscriber.overruns, 4);
+  p = RecordPut(p, &mpu6050Subscriber.overruns, 4);
+  p = RecordPut(p, &gpsSubscriber.overruns, 4);
+  p = RecordPut(p, &refused, 4);
+  p = RecordPut(p, &imu6050.fifoOverflows, 4);
+  p = RecordPut(p, &nanoImu.packetsDropped, 4);
+
+  /* Last Error_Handler call, the file without its path (zero padded) */
+  p = RecordPut(p, &error.flag, 1);
+  p = RecordPut(p, &error.line, 4);
+  strncpy((char*) p, (file != NULL) ? file + 1 : error.file, STATUS_FILE_SIZE);
+  p += STATUS_FILE_SIZE;
+
+  return (uint16_t)(p - record);
+}
+
+static uint8_t* RecordPut(uint8_t* record, const void* field, uint16_t size)
+{
+  memcpy(record, field, size);
+  return record + size;
+}
+
+/**
+  * @brief  Makes room for the next telemetry record, the staged ones go to
+  *         the USB queue when the buffer is full
+  * @param  payloadLength: Payload of the next record
+  * @retval 1 if the record can be added, 0 if the USB queue is full (the
+  *         samples wait in the bus for the next cycle)
+  */
+static uint8_t TelemetryRoom(uint16_t payloadLength)
+{
+  /* Nothing is read from the bus that the queue could not take */
+  if (CDC_TxFree_FS() < (telemetry.length + TELEMETRY_RECORD_SIZE(payloadLength)))
+    return 0;
+
+  if (!TELEMETRY_fits(&telemetry, payloadLength))
+    return TelemetryFlush();
+
+  return 1;
+}
+
+/**
+  * @brief  Queues the staged telemetry records for the USB link
+  * @retval 1 if the buffer is empty, 0 if the queue refused it (kept for
+  *         the next try)
+  */
+static uint8_t TelemetryFlush(void)
+{
+  if ((telemetry.length > 0) && (CDC_Transmit_FS(telemetry.buffer, telemetry.length) != USBD_OK))
+    return 0;
+
+  TELEMETRY_clear(&telemetry);
+  return 1;
+}
+
+/**
+  * @brief  Stages a sample record, in GPS time once the GPS clock has a
+  *         solution, in local time before
+  * @param  stream: TELEMETRY_x
+  * @param  sequence: Position of the sample in its topic
+  * @param  localTime: Local time of the sample [us]
+  * @param  payload: Record payload
+  * @param  length: Payload length [bytes]
+  * @retval None
+  */
+static void TelemetryAddSample(uint8_t stream, uint16_t sequence, uint64_t localTime, const void* payload,
+                               uint16_t length)
+{
+  uint64_t gpsTime = GPSCLOCK_gpsTimeFromLocal(&gpsClock, localTime);
+
+  if (gpsTime != 0)
+    TELEMETRY_add(&telemetry, stream | TELEMETRY_GPS_TIME, sequence, gpsTime, payload, length);
+  else
+    TELEMETRY_add(&telemetry, stream, sequence, localTime, payload, length);
+}
+
+/**
+  * @brief  Wakes a task from an interrupt (direct to task notification)
+  * @param  task: Task to wake, NULL before it is created
+  * @retval None
+  */
+static void NotifyTaskFromISR(osThreadId task)
+{
+  BaseType_t woken = pdFALSE;
+
+  /* The UARTs start receiving before the tasks are created */
+  if (task == NULL)
+    return;
+
+  vTaskNotifyGiveFromISR(task, &woken);
+  portYIELD_FROM_ISR(woken);
+}
+
+/**
+  * @brief  USART1 circular DMA span handler (interrupt context)
+  * @param  data: New bytes in the DMA buffer
+  * @param  length: Number of bytes
+  * @param  context: NanoIMU
+  * @retval None
+  */
+static void NanoImuSpanCallback(const uint8_t* data, uint16_t length, void* context)
+{
+  /* The framer finds the packets wherever the spans cut them, stamped on
+     arrival for the device timer mapping */
+  NANOIMU_pushBytesAt((MEMSenseImu*) context, data, length, TIMESTAMP_now());
+}
+
+/**
+  * @brief  Validated NanoIMU packet handler (interrupt context)
+  * @param  sample: Decoded packet (Q31 engineering units)
+  * @param  context: NanoIMU sample ring
+  * @retval None
+  */
+static void NanoImuPacketCallback(const MEMSenseSample* sample, void* context)
+{
+  /* Timed by the device clock, not by the arrival */
+  IMURING_push((IMURing*) context, sample->channel, sample->time);
+  SAMPLEBUS_publish(&nanoImuTopic, sample);
+  LATESTVALUE_write(&nanoImuLatest, sample);
+  NotifyTaskFromISR(imuComTaskHandle);
+}
+
+/**
+  * @brief  MPU6050 sample read completed handler (interrupt context)
+  * @param  imu: MPU6050, the burst is in fifoData
+  * @param  context: MPU6050 sample ring
+  * @retval None
+  */
+static void Mpu6050ReadCallback(MPU6050Imu* imu, void* context)
+{
+  MPU6050Sample sample;
+
+  /* Oldest first, each timed back from the edge that started the burst */
+  for (uint16_t i = 0; i < imu->fifoSamples; i++)
+  {
+    MPU6050_fifoSample(imu, i, &sample);
+    IMURING_push((IMURing*) context, sample.channel, sample.time);
+    SAMPLEBUS_publish(&mpu6050Topic, &sample);
+  }
+  if (imu->fifoSamples > 0)
+  {
+    LATESTVALUE_write(&mpu6050Latest, &sample);
+  }
+  NotifyTaskFromISR(imuComTaskHandle);
+}
+
+/**
+  * @brief  EXTI line detection callback
+  * @param  GPIO_Pin: Pin of the EXTI line
+  * @retval None
+  */
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
+{
+  /* MPU6050 data ready: start the read, no blocking on the bus here */
+  if (GPIO_Pin == MPU_INT_Pin)
+  {
+    MPU6050_dataReady(&imu6050, TIMESTAMP_now());
+  }
+}
+
+/**
+  * @brief  I2C memory read completed callback
+  * @param  hi2c: I2C handle
+  * @retval None
+  */
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+  if (hi2c->Instance == I2C1)
+  {
+    MPU6050_readComplete(&imu6050);
+  }
+}
+
+/**
+  * @brief  I2C memory write completed callback
+  * @param  hi2c: I2C handle
+  * @retval None
+  */
+void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+  if (hi2c->Instance == I2C1)
+  {
+    MPU6050_writeComplete(&imu6050);
   }
 }
 
+/**
+  * @brief  I2C error callback
+  * @param  hi2c: I2C handle
+  * @retval None
+  */
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c)
+{
+  if (hi2c->Instance == I2C1)
+  {
+    MPU6050_readError(&imu6050);
+  }
+}
+
+/**
+  * @brief  USART2 circular DMA span handler (interrupt context)
+  * @param  data: New bytes in the DMA buffer
+  * @param  length: Number of bytes
+  * @param  context: Novatel GPS
+  * @retval None
+  */
+static void NovatelGpsSpanCallback(const uint8_t* data, uint16_t length, void* context)
+{
+  /* Stamped on arrival, the framer back-dates the sync byte from the line rate */
+  NOVATELGPS_pushBytesAt((NovatelGPS*) context, data, length, TIMESTAMP_now());
+}
+
+/**
+  * @brief  Validated BESTXYZB frame handler (interrupt context)
+  * @param  frame: Frame still in the framer buffer
+  * @param  context: Not used
+  * @retval None
+  */
+static void NovatelGpsBestxyzCallback(const NovatelFrame* frame, void* context)
+{
+  if (BESTXYZ_isValid(frame))
+  {
+    BestxyzSample sample;
+
+    gpsBestxyzCount++;
+    BESTXYZ_toSample(frame, &sample);
+    SAMPLEBUS_publish(&gpsTopic, &sample);
+    LATESTVALUE_write(&gpsLatest, &sample);
+  }
+}
+
+/**
+  * @brief  Time transfer from every validated NovAtel frame (interrupt context)
+  * @param  week: GPS week of the frame header
+  * @param  milliseconds: GPS milliseconds of week of the frame header
+  * @param  localTime: Local time of the frame sync
+  * @param  context: GPSClock to feed
+  * @retval None
+  */
+static void NovatelGpsTimeCallback(uint16_t week, uint32_t milliseconds, uint64_t localTime, void* context)
+{
+  GPSCLOCK_frame((GPSClock*) context, week, milliseconds, localTime);
+}
+
+/**
+  * @brief  Switches USART2 to the rate under test during GPS bring-up
+  * @param  baudRate: New rate
+  * @param  context: USART2 circular DMA reception
+  * @retval None
+  */
+static void NovatelGpsBaudCallback(uint32_t baudRate, void* context)
+{
+  UARTDMA_setBaudRate((UARTDMARx*) context, baudRate);
+}
+
 /**
   * @brief  Function implementing the gpsTask thread.
   * @param  argument: Not used 
@@ -515,6 +1033,7 @@ void ImuComTask(void const * argument)
   */
 void GpsComTask(void const * argument)
 {
+  PERIODIC_init(&gpsPeriod, GPS_TASK_RATE_HZ);
 
   for(;;)
   {
@@ -525,12 +1044,14 @@ void GpsComTask(void const * argument)
     //   Error_Handler();
     // }
 
-    // while (Uart2Ready != SET)
-    // {
-    // }
+    /* Negotiates the link rate, then starts queued receiver commands and
+       times out unanswered ones */
+    NOVATELGPS_poll(&novatelGps);
 
-    // Uart2Ready = RESET;
-    osDelay(50);
+    /* Keeps the cycle counter extension ahead of its wrap */
+    TIMESTAMP_now();
+
+    PERIODIC_wait(&gpsPeriod);
   }
 }
 
@@ -549,29 +1070,66 @@ void StartDefaultTask(void const * argument)
   MX_USB_DEVICE_Init();
 
   /* USER CODE BEGIN 5 */
-  uint8_t message[800];
+  /* Records staged for the USB queue */
+  static uint8_t message[TELEMETRY_BUFFER_SIZE];
+  static uint8_t record[TELEMETRY_MAX_PAYLOAD];
+  static MEMSenseSample nanoImuSample;
+  static MPU6050Sample mpu6050Sample;
+  static BestxyzSample gpsSample;
+  static SensorSnapshot snapshot;
+  uint16_t statusSequence = 0;
+  uint16_t length;
+
+  TELEMETRY_init(&telemetry, message, sizeof(message));
+  SAMPLEBUS_subscribe(&nanoImuTopic, &nanoImuSubscriber);
+  SAMPLEBUS_subscribe(&mpu6050Topic, &mpu6050Subscriber);
+  SAMPLEBUS_subscribe(&gpsTopic, &gpsSubscriber);
+  PERIODIC_init(&telemetryPeriod, TELEMETRY_RATE_HZ);
   /* Infinite loop */
   for(;;)
   {
-    
-    if (error.flag)
+    /* Status once a second, skipped if the USB queue is full (a sequence gap) */
+    if ((telemetryPeriod.cycles % TELEMETRY_RATE_HZ) == 0)
     {
-      message[0] = '{'
-      /* code */
-      char str[12];
-      char atr[12];
-      sprintf(str, "status %d\n", nanoImu.status);
-      CDC_Transmit_FS(str, strlen(str));
-      sprintf(atr, "led %d\n", counter);
-      CDC_Transmit_FS(atr, strlen(atr));
+      SensorSnapshotRead(&snapshot);
+      length = StatusRecord(&snapshot, record);
+      if (TelemetryRoom(length))
+        TELEMETRY_add(&telemetry, TELEMETRY_STATUS, statusSequence, TIMESTAMP_now(), record, length);
+      length = SchedRecord(SCHED_TELEMETRY, &telemetryPeriod, record);
+      if (TelemetryRoom(length))
+        TELEMETRY_add(&telemetry, TELEMETRY_SCHED, statusSequence, TIMESTAMP_now(), record, length);
+      length = SchedRecord(SCHED_GPS, &gpsPeriod, record);
+      if (TelemetryRoom(length))
+        TELEMETRY_add(&telemetry, TELEMETRY_SCHED, statusSequence, TIMESTAMP_now(), record, length);
+      statusSequence++;
     }
-    else
-    {
 
+    /* Every sample the USB queue can take, the others wait in the bus (and
+       are counted as overruns if they have to). The sequence is the
+       sample's position in the topic */
+    while (TelemetryRoom(GPS_RECORD_SIZE) && SAMPLEBUS_read(&gpsSubscriber, &gpsSample))
+    {
+      length = GpsRecord(&gpsSample, record);
+      /* The solution carries its own GPS time, exact where the clock model
+         would add the output latency */
+      TELEMETRY_add(&telemetry, TELEMETRY_GPS | TELEMETRY_GPS_TIME, (uint16_t)(gpsSubscriber.cursor - 1),
+                    (uint64_t)gpsSample.week * GPS_WEEK_US + (uint64_t)gpsSample.milliseconds * 1000, record, length);
     }
-    // CDC_Transmit_FS(nanoImu.data, IMU_PACKET_SIZE);
-    /*100 Hz*/
-    osDelay(100);
+    while (TelemetryRoom(sizeof(nanoImuSample.channel)) && SAMPLEBUS_read(&nanoImuSubscriber, &nanoImuSample))
+    {
+      TelemetryAddSample(TELEMETRY_NANOIMU, (uint16_t)(nanoImuSubscriber.cursor - 1), nanoImuSample.time,
+                         nanoImuSample.channel, sizeof(nanoImuSample.channel));
+    }
+    while (TelemetryRoom(sizeof(mpu6050Sample.channel)) && SAMPLEBUS_read(&mpu6050Subscriber, &mpu6050Sample))
+    {
+      TelemetryAddSample(TELEMETRY_MPU6050, (uint16_t)(mpu6050Subscriber.cursor - 1), mpu6050Sample.time,
+                         mpu6050Sample.channel, sizeof(mpu6050Sample.channel));
+    }
+
+    TelemetryFlush();
+
+    /* 100 Hz, on the tick grid whatever the cycle took */
+    PERIODIC_wait(&telemetryPeriod);
   }
   /* USER CODE END 5 */ 
 }
@@ -607,13 +1165,11 @@ void _Error_Handler(char *file, int line)
 {
   /* USER CODE BEGIN Error_Handler_Debug */
   /* User can add his own implementation to report the HAL error return state */
-  while(1)
-  {
-    error.flag = 1;
-    strcpy(error.file, file);
-    error.line = line;
-    break;
-  }
+  /* Reported in the telemetry status, flag last so the status never reads
+     it before the location */
+  strncpy(error.file, file, sizeof(error.file) - 1);
+  error.line = line;
+  error.flag = 1;
   /* USER CODE END Error_Handler_Debug */
 }
 
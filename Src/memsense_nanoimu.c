@@ -59,6 +59,7 @@
  */
 
 
+#include <string.h>
 #include "stm32f1xx_hal.h"
 #include "memsense_nanoimu.h"
 
@@ -75,30 +76,125 @@
 
 #define BYTE_SIZE_2READ     1
 
+// Q15 count -> Q31 fraction of the sensor range: DS (in output units) * 2^31 / 2^range.
+// Every count times its scale fits 32 bits, no saturation needed
+#define DEG2RAD             0.017453292519943295
+#define STD_GRAVITY         9.80665
+#define NANOIMU_SCALE(ds, range)  ((int32_t)((ds)*2147483648.0/(1 << (range)) + 0.5))
+#define NANOIMU_UNIT(range)       ((float)(1 << (range))/2147483648.0f)
+
+static const int32_t NANOIMU_scale[NANOIMU_CHANNELS] =
+{
+    NANOIMU_SCALE(DS_GYR*DEG2RAD, NANOIMU_GYR_RANGE),
+    NANOIMU_SCALE(DS_GYR*DEG2RAD, NANOIMU_GYR_RANGE),
+    NANOIMU_SCALE(DS_GYR*DEG2RAD, NANOIMU_GYR_RANGE),
+    NANOIMU_SCALE(DS_ACC*STD_GRAVITY, NANOIMU_ACC_RANGE),
+    NANOIMU_SCALE(DS_ACC*STD_GRAVITY, NANOIMU_ACC_RANGE),
+    NANOIMU_SCALE(DS_ACC*STD_GRAVITY, NANOIMU_ACC_RANGE),
+    NANOIMU_SCALE(DS_MAG, NANOIMU_MAG_RANGE),
+    NANOIMU_SCALE(DS_MAG, NANOIMU_MAG_RANGE),
+    NANOIMU_SCALE(DS_MAG, NANOIMU_MAG_RANGE),
+    NANOIMU_SCALE(DS_TMP, NANOIMU_TMP_RANGE),
+    NANOIMU_SCALE(DS_TMP, NANOIMU_TMP_RANGE),
+    NANOIMU_SCALE(DS_TMP, NANOIMU_TMP_RANGE)
+};
+
+static const float NANOIMU_unit[NANOIMU_CHANNELS] =
+{
+    NANOIMU_UNIT(NANOIMU_GYR_RANGE), NANOIMU_UNIT(NANOIMU_GYR_RANGE), NANOIMU_UNIT(NANOIMU_GYR_RANGE),
+    NANOIMU_UNIT(NANOIMU_ACC_RANGE), NANOIMU_UNIT(NANOIMU_ACC_RANGE), NANOIMU_UNIT(NANOIMU_ACC_RANGE),
+    NANOIMU_UNIT(NANOIMU_MAG_RANGE), NANOIMU_UNIT(NANOIMU_MAG_RANGE), NANOIMU_UNIT(NANOIMU_MAG_RANGE),
+    NANOIMU_UNIT(NANOIMU_TMP_RANGE), NANOIMU_UNIT(NANOIMU_TMP_RANGE), NANOIMU_UNIT(NANOIMU_TMP_RANGE)
+};
+
 uint16_t timeout;
 
-int8_t NANOIMU_checksum(uint8_t *data, uint8_t chksum);
+static void NANOIMU_frameByte(MEMSenseImu* nanoImu, uint8_t data_read);
+static uint8_t NANOIMU_parseByte(MEMSenseImu* nanoImu, uint8_t data_read);
+static uint8_t NANOIMU_findSync(const uint8_t* data, uint8_t length);
+static void NANOIMU_timeSample(MEMSenseImu* nanoImu, MEMSenseSample* sample);
+static uint64_t NANOIMU_ticksToTime(const MEMSenseImu* nanoImu, uint64_t ticks);
 
 void NANOIMU_configDevice(MEMSenseImu* nanoImu, UART_HandleTypeDef* interface)
 {
     timeout = 100;
     nanoImu->messageSize = IMU_PACKET_SIZE;
     nanoImu->UARTInterface = interface;
+
+    // Framer starts out of sync
+    nanoImu->s = IMU_SYNC_ST;
+    nanoImu->b = 0;
+    nanoImu->recovering = 0;
+    nanoImu->packetCount = 0;
+    nanoImu->bytesDiscarded = 0;
+    nanoImu->packetsRecovered = 0;
+    nanoImu->lineError = 0;
+    nanoImu->lineErrors = 0;
+
+    // Ten bits a character (8N1)
+    nanoImu->spanTime = 0;
+    nanoImu->spanLeft = 0;
+    nanoImu->byteTimeNs = 10000000000ULL / interface->Init.BaudRate;
+    nanoImu->packetTime = 0;
+
+    nanoImu->ticks = 0;
+    nanoImu->period = NANOIMU_TIMER_HZ / NANOIMU_RATE_HZ;
+    nanoImu->packetsDropped = 0;
+    nanoImu->timerRate = NANOIMU_TIMER_HZ;
+    nanoImu->baseTime = 0;
+    nanoImu->windowStart = 0;
+
+    nanoImu->packetCallback = NULL;
+    nanoImu->callbackContext = NULL;
+}
+
+void NANOIMU_setPacketCallback(MEMSenseImu* nanoImu, MEMSensePacketCallback callback, void* context)
+{
+    nanoImu->callbackContext = context;
+    nanoImu->packetCallback = callback;
+}
+
+void NANOIMU_pushBytes(MEMSenseImu* nanoImu, const uint8_t* buffer, uint32_t length)
+{
+    NANOIMU_pushBytesAt(nanoImu, buffer, length, 0);
+}
+
+void NANOIMU_pushBytesAt(MEMSenseImu* nanoImu, const uint8_t* buffer, uint32_t length, uint64_t lastByteTime)
+{
+    nanoImu->spanTime = lastByteTime;
+
+    // Packets may start and end anywhere in the span, the framer state
+    // carries over to the next one
+    for(uint32_t i = 0; i < length; i++)
+    {
+        nanoImu->spanLeft = length - 1 - i;
+        NANOIMU_frameByte(nanoImu, buffer[i]);
+    }
+}
+
+void NANOIMU_lineError(MEMSenseImu* nanoImu, uint32_t error)
+{
+    nanoImu->lineError = error;
+    nanoImu->lineErrors++;
+
+    // Bytes were lost with the error, the packet in progress cannot pass
+    // its checksum: drop it and hunt for the next sync
+    nanoImu->bytesDiscarded += nanoImu->b;
+    nanoImu->recovering = 0;
+    nanoImu->b = 0;
+    nanoImu->s = IMU_SYNC_ST;
 }
 
 void NANOIMU_geData(MEMSenseImu* nanoImu)
 {
     int32_t i;
-    int32_t data_ready = 0;
-
-    // State machine variables
-    int32_t b = 0, s = IMU_SYNC_ST;
+    uint32_t packet_count = nanoImu->packetCount;
 
     // Storage for data read from serial port
     uint8_t data_read;
 
     // Try to sync with IMU and get latest data packet, up to MAX_BYTES read until failure
-    for(i = 0; (!data_ready)&&(i < MAX_BYTES); i++)
+    for(i = 0; (nanoImu->packetCount == packet_count)&&(i < MAX_BYTES); i++)
     {
         // Read data from serial port
         if(HAL_UART_Receive(nanoImu->UARTInterface, &data_read, BYTE_SIZE_2READ, timeout) != HAL_OK)
@@ -106,101 +202,278 @@ void NANOIMU_geData(MEMSenseImu* nanoImu)
             Error_Handler();
         }
 
-        // Parse IMU packet (User Guide, p.7)
-        switch(s)
-        {
-            case IMU_SYNC_ST:
-            {
-                // State logic: Packet starts with 4 sync bytes with value 0xFF
-                if(data_read == D_SYNC)
-                {
-                    nanoImu->data[b] = data_read;
-                    b++;
-                }
-                else
-                    // Out of sync, reset
-                    b = 0;
+        NANOIMU_frameByte(nanoImu, data_read);
+    }
+}
 
-                // State transition: I have reached the MSG_SIZE byte without resetting
-                if(b == MSG_SIZE)
-                    s = IMU_HEADER_ST;
-            }
+void NANOIMU_decode(const uint8_t* packet, MEMSenseSample* sample)
+{
+    const uint8_t* p = &packet[GYRX_MSB];
+
+    // One pass over the 12 channels (big-endian, contiguous from GYRX): sign
+    // extend the count and scale it with a single 32 bit multiply
+    for(uint8_t i = 0; i < NANOIMU_CHANNELS; i++, p += 2)
+        sample->channel[i] = (int32_t)(int16_t)((p[0] << 8) | p[1]) * NANOIMU_scale[i];
+}
+
+void NANOIMU_toFloat(const MEMSenseSample* sample, MEMSenseSampleF* sampleF)
+{
+    // Soft-float on the M3, for logging and tools rather than per sample filtering
+    for(uint8_t i = 0; i < NANOIMU_CHANNELS; i++)
+        sampleF->channel[i] = (float)sample->channel[i] * NANOIMU_unit[i];
+}
+
+static void NANOIMU_frameByte(MEMSenseImu* nanoImu, uint8_t data_read)
+{
+    uint8_t held = NANOIMU_parseByte(nanoImu, data_read);
+
+    // Rejected packet: the next one may start inside its bytes, replay them
+    // from the next sync. In place, a replayed byte is never written past the
+    // one being read
+    while(held > 0)
+    {
+        uint8_t start = NANOIMU_findSync(nanoImu->data, held);
+        uint8_t i, failed = 0;
+
+        nanoImu->bytesDiscarded += start;
+        if(start == held)
             break;
 
-            case IMU_HEADER_ST:
+        nanoImu->recovering = 1;
+        for(i = start; (i < held) && (failed == 0); i++)
+            failed = NANOIMU_parseByte(nanoImu, nanoImu->data[i]);
+
+        // Rejected again: its bytes are at the start of data, the ones not
+        // replayed yet go right after them
+        memmove(&nanoImu->data[failed], &nanoImu->data[i], held - i);
+        held = failed + (held - i);
+        if(failed == 0)
+            break;
+    }
+}
+
+// Returns 0, or for a rejected packet the number of its bytes left in data
+static uint8_t NANOIMU_parseByte(MEMSenseImu* nanoImu, uint8_t data_read)
+{
+    uint8_t held = 0;
+
+    // Checksum is the sum of every byte before it, so it is updated here and
+    // the checksum state only has to compare
+    if((nanoImu->s == IMU_SYNC_ST) && (nanoImu->b == SYNC0))
+        nanoImu->sum = 0;
+    if(nanoImu->s != IMU_CHECKSUM_ST)
+        nanoImu->sum += data_read;
+
+    // Parse IMU packet (User Guide, p.7)
+    switch(nanoImu->s)
+    {
+        case IMU_SYNC_ST:
+        {
+            // State logic: Packet starts with 4 sync bytes with value 0xFF
+            if(data_read == D_SYNC)
             {
-                // State logic: MSG_SIZE, DEV_ID and MSG_ID have default values
-                if((b == MSG_SIZE) && (data_read == D_MSG_SIZE))
-                {
-                    nanoImu->data[b] = data_read;
-                    b++;
-                }
-                else if((b == DEV_ID) && (data_read == D_DEV_ID))
-                {
-                    nanoImu->data[b] = data_read;
-                    b++;
-                }
-                else if((b == MSG_ID) && (data_read == D_MSG_ID))
-                {
-                    nanoImu->data[b] = data_read;
-                    b++;
-                }
-                else
-                {
-                    // Invalid MSG_SIZE, DEV_ID or MSG_ID, reset
-                    b = 0;
-                    s = IMU_SYNC_ST;
-                }
+                nanoImu->data[nanoImu->b] = data_read;
+                nanoImu->b++;
+            }
+            else
+            {
+                // Out of sync, reset (a run of sync bytes is never cut short,
+                // there is nothing to rescan)
+                nanoImu->b = 0;
+            }
 
-                // State transition: I have reached the TIME_MSB byte without resetting
-                if(b == TIME_MSB)
-                    s = IMU_PAYLOAD_ST;
+            // State transition: I have reached the MSG_SIZE byte without resetting
+            if(nanoImu->b == MSG_SIZE)
+                nanoImu->s = IMU_HEADER_ST;
+        }
+        break;
 
+        case IMU_HEADER_ST:
+        {
+            // State logic: MSG_SIZE, DEV_ID and MSG_ID have default values
+            nanoImu->data[nanoImu->b] = data_read;
+            if(((nanoImu->b == MSG_SIZE) && (data_read == D_MSG_SIZE)) ||
+               ((nanoImu->b == DEV_ID) && (data_read == D_DEV_ID)) ||
+               ((nanoImu->b == MSG_ID) && (data_read == D_MSG_ID)))
+            {
+                nanoImu->b++;
             }
-            break;
+            else
+            {
+                // Invalid MSG_SIZE, DEV_ID or MSG_ID, reset (0xFF bytes may
+                // belong to the next sync)
+                held = nanoImu->b + 1;
+                nanoImu->b = 0;
+                nanoImu->s = IMU_SYNC_ST;
+            }
+
+            // State transition: I have reached the TIME_MSB byte without resetting
+            if(nanoImu->b == TIME_MSB)
+                nanoImu->s = IMU_PAYLOAD_ST;
+        }
+        break;
 
-            case IMU_PAYLOAD_ST:
+        case IMU_PAYLOAD_ST:
+        {
+            // State logic: Grab data until you reach the checksum byte
+            nanoImu->data[nanoImu->b] = data_read;
+            nanoImu->b++;
+
+            // State transition: I have reached the checksum byte
+            if(nanoImu->b == CHECKSUM)
+                nanoImu->s = IMU_CHECKSUM_ST;
+        }
+        break;
+
+        case IMU_CHECKSUM_ST:
+        {
+            // State logic: If checksum is OK, grab data
+            nanoImu->data[nanoImu->b] = data_read;
+            if(nanoImu->sum == data_read)
             {
-                // State logic: Grab data until you reach the checksum byte
-                nanoImu->data[b] = data_read;
-                b++;
+                nanoImu->packetCount++;
+                if(nanoImu->recovering)
+                    nanoImu->packetsRecovered++;
 
-                // State transition: I have reached the checksum byte
-                if(b == CHECKSUM)
-                    s = IMU_CHECKSUM_ST;
-            }
-            break;
+                // Replays never complete a packet, so this byte is the live
+                // one. Packet time is its first sync byte
+                if(nanoImu->spanTime != 0)
+                    nanoImu->packetTime = nanoImu->spanTime - ((uint64_t)(nanoImu->spanLeft + CHECKSUM) * nanoImu->byteTimeNs) / 1000;
+                else
+                    nanoImu->packetTime = 0;
 
-            case IMU_CHECKSUM_ST:
+                NANOIMU_decode(nanoImu->data, &nanoImu->sample);
+                NANOIMU_timeSample(nanoImu, &nanoImu->sample);
+                if(nanoImu->packetCallback != NULL)
+                    nanoImu->packetCallback(&nanoImu->sample, nanoImu->callbackContext);
+            }
+            else
             {
-                // State logic: If checksum is OK, grab data
-                if(NANOIMU_checksum(nanoImu->data, data_read))
-                {
-                    nanoImu->data[b] = data_read;
-                    // decode();
-                    data_ready = 1;
-                }
-
-                // State transition: Unconditional reset
-                b = 0;
-                s = IMU_SYNC_ST;
+                held = IMU_PACKET_SIZE;
             }
-            break;
+
+            // State transition: Unconditional reset
+            nanoImu->recovering = 0;
+            nanoImu->b = 0;
+            nanoImu->s = IMU_SYNC_ST;
         }
+        break;
     }
+
+    // A rejected packet is over, its rescan starts a new one
+    if(held != 0)
+        nanoImu->recovering = 0;
+
+    return held;
 }
 
-int8_t NANOIMU_checksum(uint8_t *data, uint8_t chksum)
+// First offset after the first byte that may start a packet: four sync bytes
+// and the size, or the part of them that the data ends with. Returns length
+// if there is none
+static uint8_t NANOIMU_findSync(const uint8_t* data, uint8_t length)
 {
-    uint8_t sum = 0;
+    const uint8_t* p = data + 1;
+    const uint8_t* end = data + length;
+    uint8_t i;
+
+    // memchr is word-wide in newlib, most payload bytes are not 0xFF
+    while((p < end) && ((p = memchr(p, D_SYNC, end - p)) != NULL))
+    {
+        for(i = 1; (i < MSG_SIZE) && (p + i < end) && (p[i] == D_SYNC); i++);
+
+        if((p + i >= end) || ((i == MSG_SIZE) && (p[i] == D_MSG_SIZE)))
+            return p - data;
+
+        // A short run ends in a byte that is not 0xFF, nothing before it can
+        // start one. A long one may just start a byte later
+        p += (i < MSG_SIZE) ? i : 1;
+    }
 
-    for(uint8_t i = 0; i < D_MSG_SIZE-1; i++)
-        sum += data[i];
+    return length;
+}
+
+static void NANOIMU_timeSample(MEMSenseImu* nanoImu, MEMSenseSample* sample)
+{
+    uint16_t timer = ((uint16_t)nanoImu->data[TIME_MSB] << 8) | nanoImu->data[TIME_LSB];
+    uint64_t now = nanoImu->packetTime;
+    uint32_t delta;
 
-    if(sum != chksum)
+    if(nanoImu->packetCount == 1)
     {
-        return 0;
+        nanoImu->ticks = timer;
     }
     else
-        return 1;
+    {
+        delta = (uint16_t)(timer - nanoImu->timer);
+
+        // The timer wraps every 142 ms: a longer silence hides whole wraps,
+        // the local clock tells how many
+        if((now != 0) && (nanoImu->baseTime != 0))
+        {
+            uint64_t expected = NANOIMU_ticksToTime(nanoImu, nanoImu->ticks);
+            expected = (now > expected) ? ((now - expected) * nanoImu->timerRate) / 1000000 : 0;
+
+            if(expected > delta + 32768)
+                delta += (uint32_t)(((expected - delta + 32768) >> 16) << 16);
+        }
+        nanoImu->ticks += delta;
+
+        // More than one and a half periods: packets were lost on the way.
+        // Single steps keep the period estimate up to date
+        if(delta > nanoImu->period + nanoImu->period/2)
+            nanoImu->packetsDropped += (delta + nanoImu->period/2) / nanoImu->period - 1;
+        else if(delta > nanoImu->period/2)
+            nanoImu->period += ((int32_t)delta - (int32_t)nanoImu->period) / 8;
+    }
+    nanoImu->timer = timer;
+
+    if((now != 0) && (nanoImu->baseTime == 0))
+    {
+        // First stamped packet anchors the mapping at the nominal rate
+        nanoImu->baseTicks = nanoImu->ticks;
+        nanoImu->baseTime = now;
+    }
+
+    if(now != 0)
+    {
+        // Arrival = sample time + a latency that only adds
+        int64_t latency = (int64_t)(now - NANOIMU_ticksToTime(nanoImu, nanoImu->ticks));
+
+        if((nanoImu->windowStart == 0) || (latency < nanoImu->bestLatency))
+        {
+            nanoImu->bestTicks = nanoImu->ticks;
+            nanoImu->bestTime = now;
+            nanoImu->bestLatency = latency;
+        }
+        if(nanoImu->windowStart == 0)
+            nanoImu->windowStart = now;
+
+        // Window over: rate from the base to the best packet, which becomes
+        // the base (unless the base itself was still the best)
+        if((now - nanoImu->windowStart) >= NANOIMU_WINDOW_US)
+        {
+            if(nanoImu->bestTime > nanoImu->baseTime)
+            {
+                uint64_t rate = ((nanoImu->bestTicks - nanoImu->baseTicks) * 1000000) / (nanoImu->bestTime - nanoImu->baseTime);
+
+                // Nonsense after long outages, the crystal is within 1%
+                if((rate > NANOIMU_TIMER_HZ - NANOIMU_TIMER_HZ/100) && (rate < NANOIMU_TIMER_HZ + NANOIMU_TIMER_HZ/100))
+                    nanoImu->timerRate = (uint32_t) rate;
+
+                nanoImu->baseTicks = nanoImu->bestTicks;
+                nanoImu->baseTime = nanoImu->bestTime;
+            }
+            nanoImu->windowStart = 0;
+        }
+    }
+
+    sample->ticks = nanoImu->ticks;
+    sample->time = (nanoImu->baseTime != 0) ? NANOIMU_ticksToTime(nanoImu, nanoImu->ticks) : 0;
+}
+
+static uint64_t NANOIMU_ticksToTime(const MEMSenseImu* nanoImu, uint64_t ticks)
+{
+    int64_t elapsed = (int64_t)(ticks - nanoImu->baseTicks);
+
+    return nanoImu->baseTime + (elapsed * 1000000) / (int64_t)nanoImu->timerRate;
 }
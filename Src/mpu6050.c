@@ -7,29 +7,114 @@
 #define CONF_ADDRESS (0x6B)
 #define GYRO_ADDRESS (0x1B)
 #define ACCEL_ADDRESS (0x1C)
+#define SMPLRT_DIV_ADDRESS (0x19)
+#define CONFIG_ADDRESS (0x1A)
+#define INT_PIN_CFG_ADDRESS (0x37)
+#define INT_ENABLE_ADDRESS (0x38)
+#define FIFO_EN_ADDRESS (0x23)
+#define USER_CTRL_ADDRESS (0x6A)
+#define FIFO_COUNT_ADDRESS (0x72)
+#define FIFO_R_W_ADDRESS (0x74)
+
+/* INT pin: active high push-pull 50 us pulse, status cleared by any read */
+#define INT_PIN_CFG (0x10)
+#define DATA_RDY_EN (0x01)
+/* Temperature, gyro x y z and accel into the FIFO */
+#define FIFO_SENSORS (0xF8)
+#define USER_FIFO_EN (0x40)
+#define USER_FIFO_RESET (0x04)
+
+/* Read states */
+#define MPU_CONFIG_ST   0       /* Blocking configuration, edges ignored */
+#define MPU_IDLE_ST     1
+#define MPU_SAMPLE_ST   2       /* Reading the sample registers */
+#define MPU_COUNT_ST    3       /* Reading FIFO_COUNT */
+#define MPU_FIFO_ST     4       /* Burst from FIFO_R_W */
+#define MPU_RESET_ST    5       /* Writing FIFO_RESET after an overflow */
+
+/* Sample block: accel x y z, temperature, gyro x y z, big-endian */
+#define BLOCK_ACC       0
+#define BLOCK_TMP       3
+#define BLOCK_GYR       4
+
+/* Count -> Q31 fraction of the sensor range: LSB (in output units) * 2^31 / 2^range.
+   Every count times its scale fits 32 bits, in every device range */
+#define DEG2RAD             0.017453292519943295
+#define STD_GRAVITY         9.80665
+#define MPU6050_SCALE(lsb, range)  ((int32_t)((lsb)*2147483648.0/(1 << (range)) + 0.5))
+
+/* Per device range: 2^15 counts are 2, 4, 8, 16 g and 250, 500, 1000, 2000 deg/s */
+static const int32_t MPU6050_accScale[4] =
+{
+    MPU6050_SCALE(2.0*STD_GRAVITY/32768.0, MPU6050_ACC_RANGE),
+    MPU6050_SCALE(4.0*STD_GRAVITY/32768.0, MPU6050_ACC_RANGE),
+    MPU6050_SCALE(8.0*STD_GRAVITY/32768.0, MPU6050_ACC_RANGE),
+    MPU6050_SCALE(16.0*STD_GRAVITY/32768.0, MPU6050_ACC_RANGE)
+};
+
+static const int32_t MPU6050_gyrScale[4] =
+{
+    MPU6050_SCALE(250.0*DEG2RAD/32768.0, MPU6050_GYR_RANGE),
+    MPU6050_SCALE(500.0*DEG2RAD/32768.0, MPU6050_GYR_RANGE),
+    MPU6050_SCALE(1000.0*DEG2RAD/32768.0, MPU6050_GYR_RANGE),
+    MPU6050_SCALE(2000.0*DEG2RAD/32768.0, MPU6050_GYR_RANGE)
+};
+
+/* degC = count/340 + 36.53 */
+#define MPU6050_TMP_SCALE   MPU6050_SCALE(1.0/340.0, MPU6050_TMP_RANGE)
+#define MPU6050_TMP_OFFSET  MPU6050_SCALE(36.53, MPU6050_TMP_RANGE)
 
 uint16_t trials, timeout;
 
 /* Private function prototypes -----------------------------------------------*/
 // void mpu6050_requestData(MPU6050Imu *imu6050, uint32_t memAddress, uint8_t *buffer);
+static void MPU6050_writeRegister(MPU6050Imu *imu6050, uint16_t address, uint8_t value);
+static void MPU6050_fifoCount(MPU6050Imu *imu6050);
+static void MPU6050_resetFifo(MPU6050Imu *imu6050);
 
 /* Body Functions ------------------------------------------------------------*/
-void MPU6050_configDevice(MPU6050Imu *imu6050, I2C_HandleTypeDef* interface, uint32_t accelConfig, uint32_t gyroConfig)
+void MPU6050_configDevice(MPU6050Imu *imu6050, I2C_HandleTypeDef* interface, uint32_t accelConfig, uint32_t gyroConfig, uint32_t dlpfConfig, uint32_t sampleDivider)
 {
+    /* Only the device's own settings, the scale tables are indexed by them */
+    if((accelConfig > MPU6050_ACCEL_16G) || (gyroConfig > MPU6050_GYRO_2000DPS) || (dlpfConfig > MPU6050_DLPF_5HZ) || (sampleDivider > 255))
+    {
+        _Error_Handler(__FILE__, __LINE__);
+    }
+
     trials = 100;
     timeout = 100;
     imu6050->I2CInterface = interface;
+    imu6050->state = MPU_CONFIG_ST;
+    imu6050->readyTime = 0;
+    imu6050->samples = 0;
+    imu6050->overruns = 0;
+    imu6050->errors = 0;
+    imu6050->fifoMode = 0;
+    imu6050->fifoBatch = 1;
+    imu6050->edges = 0;
+    imu6050->fifoResync = 0;
+    imu6050->fifoSamples = 0;
+    imu6050->fifoBacklog = 0;
+    imu6050->fifoTime = 0;
+    imu6050->fifoOverflows = 0;
+    imu6050->readCallback = NULL;
+    imu6050->callbackContext = NULL;
     imu6050->deviceAddress = MPU6050_ADDRESS;
     imu6050->memAddress = 0x3B;
     imu6050->memSize = 14;
     imu6050->config.accelScaleRange = accelConfig;
     imu6050->config.gyroScaleRange = gyroConfig;
+    imu6050->config.dlpfConfig = dlpfConfig;
+    imu6050->config.sampleDivider = sampleDivider;
+
+    /* Gyro output rate over 1 + divider */
+    imu6050->samplePeriod = (sampleDivider + 1) * ((dlpfConfig == MPU6050_DLPF_260HZ) ? 125 : 1000);
 
 
     uint16_t writeSize = 1;
     uint8_t initDevData = 0x0;
-    uint8_t initAccData = 0x0;
-    uint8_t initGyrData = 0x0;
+    uint8_t initAccData = (uint8_t)(accelConfig << 3);
+    uint8_t initGyrData = (uint8_t)(gyroConfig << 3);
     uint16_t gyroConfAddress = GYRO_ADDRESS;
     uint16_t accelConfAddress = ACCEL_ADDRESS;
     uint16_t deviceConfAddress = CONF_ADDRESS;
@@ -55,8 +140,164 @@ void MPU6050_configDevice(MPU6050Imu *imu6050, I2C_HandleTypeDef* interface, uin
         {
           _Error_Handler(__FILE__, __LINE__);
         }
+        HAL_Delay(5);
+
+        /* Sample rate, the INT pin pulses on every new sample */
+        MPU6050_writeRegister(imu6050, CONFIG_ADDRESS, (uint8_t) dlpfConfig);
+        MPU6050_writeRegister(imu6050, SMPLRT_DIV_ADDRESS, (uint8_t) sampleDivider);
+        MPU6050_writeRegister(imu6050, INT_PIN_CFG_ADDRESS, INT_PIN_CFG);
+    }
+
+}
+
+/* Samples buffered by the device, drained every batch samples. Call after
+   MPU6050_configDevice, before MPU6050_start */
+void MPU6050_configFifo(MPU6050Imu *imu6050, uint8_t batch)
+{
+    /* The burst has to fit the buffer, the backlog is drained in the next ones */
+    if((batch == 0) || (batch > MPU6050_FIFO_SAMPLES))
+    {
+        _Error_Handler(__FILE__, __LINE__);
+    }
+
+    MPU6050_writeRegister(imu6050, FIFO_EN_ADDRESS, FIFO_SENSORS);
+
+    imu6050->fifoMode = 1;
+    imu6050->fifoBatch = batch;
+}
+
+/* Enables the data ready interrupt, from here on the bus belongs to the
+   interrupt driven reads */
+void MPU6050_start(MPU6050Imu *imu6050)
+{
+    if(imu6050->fifoMode)
+        MPU6050_writeRegister(imu6050, USER_CTRL_ADDRESS, USER_FIFO_EN | USER_FIFO_RESET);
+
+    imu6050->edges = 0;
+    imu6050->state = MPU_IDLE_ST;
+    MPU6050_writeRegister(imu6050, INT_ENABLE_ADDRESS, DATA_RDY_EN);
+}
+
+void MPU6050_setReadCallback(MPU6050Imu *imu6050, MPU6050Callback callback, void* context)
+{
+    imu6050->callbackContext = context;
+    imu6050->readCallback = callback;
+}
+
+/* INT pin rising edge (EXTI interrupt): the sample registers are fresh */
+void MPU6050_dataReady(MPU6050Imu *imu6050, uint64_t time)
+{
+    if(imu6050->state == MPU_CONFIG_ST)
+        return;
+
+    /* FIFO mode: the device keeps the samples until the batch is complete */
+    if(imu6050->fifoMode && (++imu6050->edges < imu6050->fifoBatch))
+        return;
+
+    /* Previous read still on the bus: this sample is lost, or in FIFO mode
+       the burst waits for the next edge */
+    if(imu6050->state != MPU_IDLE_ST)
+    {
+        imu6050->overruns++;
+        return;
+    }
+
+    /* The bus is only released by the completion or the error callback */
+    if(imu6050->fifoMode)
+    {
+        imu6050->edges = 0;
+        imu6050->fifoTime = time;
+        MPU6050_fifoCount(imu6050);
+        return;
+    }
+
+    imu6050->readyTime = time;
+    imu6050->state = MPU_SAMPLE_ST;
+    if(HAL_I2C_Mem_Read_IT(imu6050->I2CInterface, imu6050->deviceAddress, imu6050->memAddress, I2C_MEMADD_SIZE_8BIT, imu6050->lastData, imu6050->memSize) != HAL_OK)
+    {
+        imu6050->state = MPU_IDLE_ST;
+        imu6050->errors++;
+    }
+}
+
+/* HAL_I2C_MemRxCpltCallback */
+void MPU6050_readComplete(MPU6050Imu *imu6050)
+{
+    uint16_t count, samples;
+
+    switch(imu6050->state)
+    {
+        case MPU_SAMPLE_ST:
+            imu6050->state = MPU_IDLE_ST;
+            imu6050->samples++;
+            break;
+
+        case MPU_COUNT_ST:
+            count = ((uint16_t)imu6050->fifoCount[0] << 8) | imu6050->fifoCount[1];
+
+            /* A full FIFO has dropped its oldest bytes, whole samples can no
+               longer be told apart */
+            if((count >= MPU6050_FIFO_SIZE) || ((count % MPU6050_FIFO_SAMPLE) != 0) || imu6050->fifoResync)
+            {
+                imu6050->fifoOverflows++;
+                MPU6050_resetFifo(imu6050);
+                return;
+            }
+
+            samples = count / MPU6050_FIFO_SAMPLE;
+            if(samples == 0)
+            {
+                imu6050->state = MPU_IDLE_ST;
+                return;
+            }
+            if(samples > MPU6050_FIFO_SAMPLES)
+                samples = MPU6050_FIFO_SAMPLES;
+
+            imu6050->fifoSamples = samples;
+            imu6050->fifoBacklog = count / MPU6050_FIFO_SAMPLE - samples;
+
+            /* The whole batch in one transaction */
+            imu6050->state = MPU_FIFO_ST;
+            if(HAL_I2C_Mem_Read_IT(imu6050->I2CInterface, imu6050->deviceAddress, FIFO_R_W_ADDRESS, I2C_MEMADD_SIZE_8BIT, imu6050->fifoData, samples * MPU6050_FIFO_SAMPLE) != HAL_OK)
+            {
+                imu6050->state = MPU_IDLE_ST;
+                imu6050->errors++;
+            }
+            return;
+
+        case MPU_FIFO_ST:
+            imu6050->state = MPU_IDLE_ST;
+            imu6050->samples += imu6050->fifoSamples;
+            break;
+
+        default:
+            return;
+    }
+
+    if(imu6050->readCallback != NULL)
+        imu6050->readCallback(imu6050, imu6050->callbackContext);
+}
+
+/* HAL_I2C_MemTxCpltCallback */
+void MPU6050_writeComplete(MPU6050Imu *imu6050)
+{
+    if(imu6050->state == MPU_RESET_ST)
+    {
+        imu6050->fifoResync = 0;
+        imu6050->state = MPU_IDLE_ST;
     }
+}
 
+/* HAL_I2C_ErrorCallback: HAL has already stopped the transfer, the next data
+   ready starts over */
+void MPU6050_readError(MPU6050Imu *imu6050)
+{
+    /* A cut burst leaves the FIFO off a sample boundary */
+    if((imu6050->state == MPU_FIFO_ST) || (imu6050->state == MPU_RESET_ST))
+        imu6050->fifoResync = 1;
+
+    imu6050->state = MPU_IDLE_ST;
+    imu6050->errors++;
 }
 
 void MPU6050_geData(MPU6050Imu *imu6050)
@@ -66,13 +307,73 @@ void MPU6050_geData(MPU6050Imu *imu6050)
     uint32_t size = imu6050->memSize;
     uint8_t *data = imu6050->lastData;
 
-    /* Request and Get Data */
-    if(HAL_I2C_IsDeviceReady(imu6050->I2CInterface, deviceAddress, trials, timeout) == HAL_OK)
+    /* Request and Get Data (blocking, for use without the INT pin) */
+    if(HAL_I2C_Mem_Read(imu6050->I2CInterface, deviceAddress, memAddress, I2C_MEMADD_SIZE_8BIT, data, size, timeout) != HAL_OK)
     {
-        if(HAL_I2C_Mem_Read(imu6050->I2CInterface, deviceAddress, memAddress, I2C_MEMADD_SIZE_8BIT, data, size, timeout) != HAL_OK)
-        {
-          _Error_Handler(__FILE__, __LINE__);
-        }
+      _Error_Handler(__FILE__, __LINE__);
+    }
+
+}
+
+void MPU6050_decode(const MPU6050Imu *imu6050, const uint8_t* data, MPU6050Sample* sample)
+{
+    int16_t count[7];
+    int32_t accScale = MPU6050_accScale[imu6050->config.accelScaleRange];
+    int32_t gyrScale = MPU6050_gyrScale[imu6050->config.gyroScaleRange];
+
+    /* One pass of byte swaps over the block, then a 32 bit multiply each */
+    for(uint8_t i = 0; i < 7; i++, data += 2)
+        count[i] = (int16_t)((data[0] << 8) | data[1]);
+
+    for(uint8_t i = 0; i < 3; i++)
+    {
+        sample->channel[MPU6050_GYR + i] = (int32_t)count[BLOCK_GYR + i] * gyrScale;
+        sample->channel[MPU6050_ACC + i] = (int32_t)count[BLOCK_ACC + i] * accScale;
+    }
+    sample->channel[MPU6050_TMP] = (int32_t)count[BLOCK_TMP] * MPU6050_TMP_SCALE + MPU6050_TMP_OFFSET;
+
+    sample->time = imu6050->readyTime;
+}
+
+/* Sample index of the last burst, oldest first. The newest sample still in
+   the FIFO arrived with the edge that started the burst */
+void MPU6050_fifoSample(const MPU6050Imu *imu6050, uint16_t index, MPU6050Sample* sample)
+{
+    uint32_t age = (uint32_t)(imu6050->fifoSamples - 1 - index) + imu6050->fifoBacklog;
+
+    MPU6050_decode(imu6050, &imu6050->fifoData[index * MPU6050_FIFO_SAMPLE], sample);
+    sample->time = imu6050->fifoTime - (uint64_t)age * imu6050->samplePeriod;
+}
+
+static void MPU6050_fifoCount(MPU6050Imu *imu6050)
+{
+    imu6050->state = MPU_COUNT_ST;
+    if(HAL_I2C_Mem_Read_IT(imu6050->I2CInterface, imu6050->deviceAddress, FIFO_COUNT_ADDRESS, I2C_MEMADD_SIZE_8BIT, imu6050->fifoCount, 2) != HAL_OK)
+    {
+        imu6050->state = MPU_IDLE_ST;
+        imu6050->errors++;
+    }
+}
+
+static void MPU6050_resetFifo(MPU6050Imu *imu6050)
+{
+    /* Written from the interrupt, the value has to outlive the call */
+    imu6050->userCtrl = USER_FIFO_EN | USER_FIFO_RESET;
+
+    imu6050->state = MPU_RESET_ST;
+    if(HAL_I2C_Mem_Write_IT(imu6050->I2CInterface, imu6050->deviceAddress, USER_CTRL_ADDRESS, I2C_MEMADD_SIZE_8BIT, &imu6050->userCtrl, 1) != HAL_OK)
+    {
+        imu6050->fifoResync = 1;
+        imu6050->state = MPU_IDLE_ST;
+        imu6050->errors++;
     }
+}
 
+static void MPU6050_writeRegister(MPU6050Imu *imu6050, uint16_t address, uint8_t value)
+{
+    if(HAL_I2C_Mem_Write(imu6050->I2CInterface, imu6050->deviceAddress, address, I2C_MEMADD_SIZE_8BIT, &value, 1, timeout) != HAL_OK)
+    {
+      _Error_Handler(__FILE__, __LINE__);
+    }
+    HAL_Delay(5);
 }
@@ -0,0 +1,411 @@
+/**
+ ******************************************************************************
+ * @file      nmea_parser.c
+ * @author    Gabriel F P Araujo
+ * @date      17/10/2026
+ ******************************************************************************
+ *
+ * @attention Copyright (C) 2018
+ * @attention Laboratório de Automação e Robótica (LARA)
+ * @attention Departamento de Engenharia Elétrica (ENE)
+ * @attention Universidade de Brasília (UnB)
+ */
+
+#include <string.h>
+#include "stm32f1xx_hal.h"
+#include "nmea_parser.h"
+
+/* Definitions */
+
+// Parser States
+#define NMEA_SYNC_ST        0
+#define NMEA_FIELD_ST       1
+#define NMEA_CHECKSUM_ST    2
+
+// Sentence formatter, last 3 characters of the address field
+#define NMEA_ADDRESS(a, b, c)   (((uint32_t)(a) << 16) | ((uint32_t)(b) << 8) | (uint32_t)(c))
+#define ADDRESS_GGA     NMEA_ADDRESS('G', 'G', 'A')
+#define ADDRESS_GSA     NMEA_ADDRESS('G', 'S', 'A')
+#define ADDRESS_RMC     NMEA_ADDRESS('R', 'M', 'C')
+#define ADDRESS_LEN     5   // Talker (2) + formatter (3)
+
+/* GGA fields */
+#define GGA_TIME        1   // hhmmss.ss
+#define GGA_LAT         2   // ddmm.mmmmm
+#define GGA_NS          3   // N/S
+#define GGA_LON         4   // dddmm.mmmmm
+#define GGA_EW          5   // E/W
+#define GGA_QUALITY     6
+#define GGA_SATS        7
+#define GGA_HDOP        8
+#define GGA_ALT         9   // [m]
+#define GGA_SEP         11  // [m]
+
+/* RMC fields */
+#define RMC_TIME        1
+#define RMC_STATUS      2   // A/V
+#define RMC_LAT         3
+#define RMC_NS          4
+#define RMC_LON         5
+#define RMC_EW          6
+#define RMC_SPEED       7   // [knot]
+#define RMC_COURSE      8   // [deg]
+#define RMC_DATE        9   // ddmmyy
+#define RMC_MODE        12  // NMEA 2.3 and later
+
+/* GSA fields */
+#define GSA_MODE        1   // M/A
+#define GSA_FIX         2
+#define GSA_PRN         3   // 12 fields
+#define GSA_PDOP        15
+#define GSA_HDOP        16
+#define GSA_VDOP        17
+
+// Fractional digits kept for each kind of field
+#define DEC_TIME        3   // ms
+#define DEC_COORD       5   // 1e-5 min
+#define DEC_DOP         2
+#define DEC_ALT         3   // mm
+#define DEC_SPEED       3
+#define DEC_COURSE      2
+
+static const uint32_t NMEAPARSER_pow10[] = {1, 10, 100, 1000, 10000, 100000};
+
+static void NMEAPARSER_startField(NMEAParser* parser);
+static void NMEAPARSER_fieldByte(NMEAParser* parser, uint8_t data_read);
+static void NMEAPARSER_endField(NMEAParser* parser);
+static uint8_t NMEAPARSER_fieldDecimals(uint16_t messageId, uint8_t field);
+static int32_t NMEAPARSER_fixed(const NMEAParser* parser);
+static uint32_t NMEAPARSER_time(uint32_t hhmmss_sss);
+static int32_t NMEAPARSER_degrees(uint32_t dddmm_mmmmm);
+static int8_t NMEAPARSER_hexDigit(uint8_t c);
+
+void NMEAPARSER_init(NMEAParser* parser, NMEASentenceCallback callback, void* context)
+{
+    memset(parser, 0, sizeof(NMEAParser));
+
+    parser->s = NMEA_SYNC_ST;
+    parser->callbackContext = context;
+    parser->callback = callback;
+}
+
+void NMEAPARSER_pushBytes(NMEAParser* parser, const uint8_t* buffer, uint32_t length)
+{
+    for(uint32_t i = 0; i < length; i++)
+        NMEAPARSER_parseByte(parser, buffer[i]);
+}
+
+void NMEAPARSER_parseByte(NMEAParser* parser, uint8_t data_read)
+{
+    // '$' always starts a sentence, even in the middle of a broken one
+    if(data_read == '$')
+    {
+        parser->s = NMEA_FIELD_ST;
+        parser->length = 1;
+        parser->field = 0;
+        parser->checksum = 0;
+        parser->address = 0;
+        memset(&parser->sentence, 0, sizeof(NMEASentence));
+        NMEAPARSER_startField(parser);
+        return;
+    }
+
+    switch(parser->s)
+    {
+        case NMEA_SYNC_ST:
+        break;
+
+        case NMEA_FIELD_ST:
+        {
+            // Only printable characters are valid inside a sentence, anything
+            // else (binary logs, line noise) drops it
+            parser->length++;
+            if((data_read < 0x20) || (data_read > 0x7E) || (parser->length > NMEA_MAX_LENGTH))
+            {
+                parser->s = NMEA_SYNC_ST;
+                break;
+            }
+
+            if(data_read == '*')
+            {
+                // State transition: Last field ends at the checksum delimiter
+                NMEAPARSER_endField(parser);
+                if(parser->s == NMEA_FIELD_ST)
+                {
+                    parser->checksum_from_packet = 0;
+                    parser->digits = 0;
+                    parser->s = NMEA_CHECKSUM_ST;
+                }
+                break;
+            }
+
+            // Checksum covers every character between '$' and '*'
+            parser->checksum ^= data_read;
+
+            if(data_read == ',')
+            {
+                NMEAPARSER_endField(parser);
+                parser->field++;
+                NMEAPARSER_startField(parser);
+            }
+            else
+                NMEAPARSER_fieldByte(parser, data_read);
+        }
+        break;
+
+        case NMEA_CHECKSUM_ST:
+        {
+            // State logic: Two hex digits, most significant first
+            int8_t nibble = NMEAPARSER_hexDigit(data_read);
+
+            if(nibble < 0)
+            {
+                parser->s = NMEA_SYNC_ST;
+                break;
+            }
+
+            parser->checksum_from_packet = (parser->checksum_from_packet << 4) | (uint8_t)nibble;
+            parser->digits++;
+
+            if(parser->digits == 2)
+            {
+                if(parser->checksum_from_packet == parser->checksum)
+                {
+                    parser->sentenceCount++;
+                    if(parser->callback != NULL)
+                        parser->callback(&parser->sentence, parser->callbackContext);
+                }
+                else
+                    parser->checksumErrors++;
+
+                // State transition: Unconditional reset, <CR><LF> is not needed
+                parser->s = NMEA_SYNC_ST;
+            }
+        }
+        break;
+    }
+}
+
+static void NMEAPARSER_startField(NMEAParser* parser)
+{
+    parser->value = 0;
+    parser->digits = 0;
+    parser->decimals = 0;
+    parser->fraction = 0;
+    parser->negative = 0;
+    parser->invalid = 0;
+    parser->character = 0;
+
+    // Decimals are fixed per field, extra digits are dropped as they arrive
+    // so the integer never overflows
+    parser->maxDecimals = NMEAPARSER_fieldDecimals(parser->sentence.messageId, parser->field);
+}
+
+static void NMEAPARSER_fieldByte(NMEAParser* parser, uint8_t data_read)
+{
+    if(parser->field == 0)
+    {
+        // Address field: only the sentence formatter matters
+        parser->address = ((parser->address << 8) | data_read) & 0xFFFFFF;
+        parser->digits++;
+        return;
+    }
+
+    if(parser->character == 0)
+        parser->character = data_read;
+
+    if((data_read >= '0') && (data_read <= '9'))
+    {
+        uint8_t digit = data_read - '0';
+
+        // Digits past the field's resolution are truncated
+        if(parser->fraction && (parser->decimals == parser->maxDecimals))
+            return;
+
+        if(parser->value > (UINT32_MAX - digit) / 10)
+        {
+            parser->invalid = 1;
+            return;
+        }
+
+        parser->value = parser->value*10 + digit;
+        parser->digits++;
+        if(parser->fraction)
+            parser->decimals++;
+    }
+    else if((data_read == '.') && (!parser->fraction))
+        parser->fraction = 1;
+    else if((data_read == '-') && (parser->digits == 0) && (!parser->negative) && (!parser->fraction))
+        parser->negative = 1;
+    else
+        // Not a number, only the first character is kept
+        parser->invalid = 1;
+}
+
+static void NMEAPARSER_endField(NMEAParser* parser)
+{
+    NMEASentence* sentence = &parser->sentence;
+    uint8_t number = (parser->digits != 0) && (!parser->invalid);
+
+    if(parser->field == 0)
+    {
+        // Sentences nobody decodes are dropped here, before their fields
+        if(parser->digits != ADDRESS_LEN)
+            sentence->messageId = NMEA_NONE;
+        else if(parser->address == ADDRESS_GGA)
+            sentence->messageId = NMEA_GGA;
+        else if(parser->address == ADDRESS_RMC)
+            sentence->messageId = NMEA_RMC;
+        else if(parser->address == ADDRESS_GSA)
+            sentence->messageId = NMEA_GSA;
+        else
+            sentence->messageId = NMEA_NONE;
+
+        if(sentence->messageId == NMEA_NONE)
+            parser->s = NMEA_SYNC_ST;
+        return;
+    }
+
+    switch(sentence->messageId)
+    {
+        case NMEA_GGA:
+        {
+            NMEAGga* gga = &sentence->data.gga;
+
+            switch(parser->field)
+            {
+                case GGA_TIME:      if(number) gga->time = NMEAPARSER_time(NMEAPARSER_fixed(parser)); break;
+                case GGA_LAT:       if(number) gga->latitude = NMEAPARSER_degrees(NMEAPARSER_fixed(parser)); break;
+                case GGA_NS:        if(parser->character == 'S') gga->latitude = -gga->latitude; break;
+                case GGA_LON:       if(number) gga->longitude = NMEAPARSER_degrees(NMEAPARSER_fixed(parser)); break;
+                case GGA_EW:        if(parser->character == 'W') gga->longitude = -gga->longitude; break;
+                case GGA_QUALITY:   if(number) gga->quality = parser->value; break;
+                case GGA_SATS:      if(number) gga->satellites = parser->value; break;
+                case GGA_HDOP:      if(number) gga->hdop = NMEAPARSER_fixed(parser); break;
+                case GGA_ALT:       if(number) gga->altitude = NMEAPARSER_fixed(parser); break;
+                case GGA_SEP:       if(number) gga->separation = NMEAPARSER_fixed(parser); break;
+            }
+        }
+        break;
+
+        case NMEA_RMC:
+        {
+            NMEARmc* rmc = &sentence->data.rmc;
+
+            switch(parser->field)
+            {
+                case RMC_TIME:      if(number) rmc->time = NMEAPARSER_time(NMEAPARSER_fixed(parser)); break;
+                case RMC_STATUS:    rmc->valid = (parser->character == 'A'); break;
+                case RMC_LAT:       if(number) rmc->latitude = NMEAPARSER_degrees(NMEAPARSER_fixed(parser)); break;
+                case RMC_NS:        if(parser->character == 'S') rmc->latitude = -rmc->latitude; break;
+                case RMC_LON:       if(number) rmc->longitude = NMEAPARSER_degrees(NMEAPARSER_fixed(parser)); break;
+                case RMC_EW:        if(parser->character == 'W') rmc->longitude = -rmc->longitude; break;
+                case RMC_SPEED:     if(number) rmc->speed = NMEAPARSER_fixed(parser); break;
+                case RMC_COURSE:    if(number) rmc->course = NMEAPARSER_fixed(parser); break;
+                case RMC_DATE:      if(number) rmc->date = parser->value; break;
+                case RMC_MODE:      rmc->mode = parser->character; break;
+            }
+        }
+        break;
+
+        case NMEA_GSA:
+        {
+            NMEAGsa* gsa = &sentence->data.gsa;
+
+            if((parser->field >= GSA_PRN) && (parser->field < GSA_PRN + NMEA_GSA_PRNS))
+            {
+                // Unused channels are empty fields
+                if(number)
+                    gsa->prn[gsa->satellites++] = parser->value;
+                break;
+            }
+
+            switch(parser->field)
+            {
+                case GSA_MODE:      gsa->mode = parser->character; break;
+                case GSA_FIX:       if(number) gsa->fixType = parser->value; break;
+                case GSA_PDOP:      if(number) gsa->pdop = NMEAPARSER_fixed(parser); break;
+                case GSA_HDOP:      if(number) gsa->hdop = NMEAPARSER_fixed(parser); break;
+                case GSA_VDOP:      if(number) gsa->vdop = NMEAPARSER_fixed(parser); break;
+            }
+        }
+        break;
+    }
+}
+
+static uint8_t NMEAPARSER_fieldDecimals(uint16_t messageId, uint8_t field)
+{
+    switch(messageId)
+    {
+        case NMEA_GGA:
+            switch(field)
+            {
+                case GGA_TIME:      return DEC_TIME;
+                case GGA_LAT:       return DEC_COORD;
+                case GGA_LON:       return DEC_COORD;
+                case GGA_HDOP:      return DEC_DOP;
+                case GGA_ALT:       return DEC_ALT;
+                case GGA_SEP:       return DEC_ALT;
+            }
+            break;
+
+        case NMEA_RMC:
+            switch(field)
+            {
+                case RMC_TIME:      return DEC_TIME;
+                case RMC_LAT:       return DEC_COORD;
+                case RMC_LON:       return DEC_COORD;
+                case RMC_SPEED:     return DEC_SPEED;
+                case RMC_COURSE:    return DEC_COURSE;
+            }
+            break;
+
+        case NMEA_GSA:
+            switch(field)
+            {
+                case GSA_PDOP:      return DEC_DOP;
+                case GSA_HDOP:      return DEC_DOP;
+                case GSA_VDOP:      return DEC_DOP;
+            }
+            break;
+    }
+
+    return 0;
+}
+
+static int32_t NMEAPARSER_fixed(const NMEAParser* parser)
+{
+    // Pad the fractional part up to the field's fixed number of decimals
+    uint32_t value = parser->value * NMEAPARSER_pow10[parser->maxDecimals - parser->decimals];
+
+    return parser->negative ? -(int32_t)value : (int32_t)value;
+}
+
+static uint32_t NMEAPARSER_time(uint32_t hhmmss_sss)
+{
+    uint32_t ms = hhmmss_sss % 100000;
+    uint32_t mm = (hhmmss_sss / 100000) % 100;
+    uint32_t hh = hhmmss_sss / 10000000;
+
+    return hh*3600000 + mm*60000 + ms;
+}
+
+static int32_t NMEAPARSER_degrees(uint32_t dddmm_mmmmm)
+{
+    // 1e-5 min -> 1e-7 deg is x100/60, rounded
+    uint32_t deg = dddmm_mmmmm / 10000000;
+    uint32_t min = dddmm_mmmmm % 10000000;
+
+    return (int32_t)(deg*10000000 + (min*5 + 1)/3);
+}
+
+static int8_t NMEAPARSER_hexDigit(uint8_t c)
+{
+    if((c >= '0') && (c <= '9'))
+        return c - '0';
+    if((c >= 'A') && (c <= 'F'))
+        return c - 'A' + 10;
+    if((c >= 'a') && (c <= 'f'))
+        return c - 'a' + 10;
+    return -1;
+}
@@ -14,6 +14,7 @@
 #include <string.h>
 #include "stm32f1xx_hal.h"
 #include "novatel_gps.h"
+#include "novatel_crc.h"
 
 /* Definitions */
 
@@ -23,11 +24,35 @@
 #define GPS_PAYLOAD_ST      2
 #define GPS_CRC_ST          3
 
+// Command States
+#define GPS_CMD_IDLE_ST     0
+#define GPS_CMD_SENDING_ST  1
+#define GPS_CMD_WAITING_ST  2
+
+// Reply parser is outside a '<' line
+#define GPS_NO_REPLY        0xFF
+
+// Baud Negotiation States
+#define GPS_BAUD_IDLE_ST    0
+#define GPS_BAUD_PROBE_ST   1
+#define GPS_BAUD_SWITCH_ST  2
+#define GPS_BAUD_VERIFY_ST  3
+
+// Candidate rates in the order they are tried: the USART default, the
+// receiver's factory default, then the rest
+static const uint32_t NOVATELGPS_baudRates[] = {115200, 9600, 19200, 38400, 57600, 230400, 460800};
+#define GPS_BAUD_RATES  (sizeof(NOVATELGPS_baudRates)/sizeof(NOVATELGPS_baudRates[0]))
+
+// Leading CR LF drops whatever the receiver got at a wrong rate. The reply
+// (<OK and a binary VERSION log) proves the rate even with no logs running
+static const char NOVATELGPS_probe[] = "\r\nLOG VERSIONB ONCE\r\n";
+
 // Serial port
 #define TIMEOUT_US      100000
 #define MAX_BYTES       1000
 
 // Binary Message Format = 3 sync + 25 header + variable data + 4 CRC
+// Short Binary Message Format = 3 sync + 9 header + variable data + 4 CRC
 
 /* Binary Header */
 
@@ -50,72 +75,213 @@
 #define SW_VERS         26  // ushort
 #define DATA            28  // variable
 
+/* Short Binary Header */
+
+// Header byte order/format (after the same 3 sync bytes)
+#define SH_MSG_LEN      3   // uchar
+#define SH_MSG_ID       4   // ushort
+#define SH_T_WEEK       6   // ushort
+#define SH_T_MS         8   // GPSec (ulong)
+#define SH_DATA         12  // variable
+
 // Default values
 #define D_SYNC0         0xAA
 #define D_SYNC1         0x44
 #define D_SYNC2         0x12
+#define D_SYNC2_SHORT   0x13
 
 // Multi-byte sizes
-#define S_MSG_ID        2
-#define S_MSG_LEN       2
-#define S_SEQ_NUM       2
-#define S_T_WEEK        2
-#define S_T_MS          4
-#define S_GPS_STATUS    4
-#define S_RESERVED      2
-#define S_SW_VERS       2
 #define S_CRC           4
 
-/* Log Message IDs */
-#define BESTPOS         42
-#define GPGGA           218
-#define GPGSA           221
-#define GPRMC           225
-#define BESTXYZ         241
-
 #define BYTE_SIZE_2READ     1
-#define BYTE_SIZE_2SEND     1
 
 uint16_t timeout;
 
-uint32_t CalculateBlockCRC32(uint32_t ulCount, uint8_t *ucBuffer);
-uint32_t ByteSwap (uint32_t n);
-uint32_t CRC32Value(int i);
-void NOVATELGPS_configure(NovatelGPS* gps);
-void NOVATELGPS_command(NovatelGPS* gps, const char* command);
-int8_t NOVATELGPS_getApproxTime(uint32_t* gps_week_1024, uint32_t* gps_secs);
+static void NOVATELGPS_frameByte(NovatelGPS* gps, uint8_t data_read);
+static uint16_t NOVATELGPS_parseByte(NovatelGPS* gps, uint8_t data_read);
+static uint16_t NOVATELGPS_findSync(const uint8_t* data, uint16_t length);
+static void NOVATELGPS_parseReply(NovatelGPS* gps, uint8_t data_read);
+static void NOVATELGPS_sendCommand(NovatelGPS* gps);
+static void NOVATELGPS_finishCommand(NovatelGPS* gps, uint8_t status);
+static void NOVATELGPS_stepBaudRate(NovatelGPS* gps);
+static void NOVATELGPS_probeBaudRate(NovatelGPS* gps, uint32_t baudRate);
+static uint32_t NOVATELGPS_syncEvents(NovatelGPS* gps);
+static void NOVATELGPS_setLineRate(NovatelGPS* gps, uint32_t baudRate);
+static char* NOVATELGPS_putText(char* out, const char* text);
+static char* NOVATELGPS_putDecimal(char* out, uint32_t value);
+static int8_t NOVATELGPS_decodeHeader(NovatelGPS* gps);
+static void NOVATELGPS_publishFrame(NovatelGPS* gps);
+static const NovatelSubscription* NOVATELGPS_lookup(NovatelGPS* gps, uint16_t msg_id);
 
 void NOVATELGPS_configDevice(NovatelGPS* gps, UART_HandleTypeDef* interface)
 {
     timeout = 100;
     gps->UARTInterface = interface;
     gps->headerSize = D_HDR_LEN;
+    gps->messageSize = 0;
+
+    // Framer starts out of sync
+    gps->s = GPS_SYNC_ST;
+    gps->b = 0;
+    gps->bb = 0;
+    gps->msg_len = 0;
+    gps->crc = NOVATEL_CRC_INIT;
+    gps->frameTime = 0;
+    gps->frameCount = 0;
+    gps->recovering = 0;
+    gps->bytesDiscarded = 0;
+    gps->framesRecovered = 0;
+    gps->lineError = 0;
+    gps->lineErrors = 0;
+    gps->frameCallback = NULL;
+    gps->callbackContext = NULL;
+    gps->timeCallback = NULL;
+    gps->timeContext = NULL;
+    gps->subscription = NULL;
+    gps->store = 0;
+    gps->writeFrame = 0;
+    gps->latestFrame = GPS_NO_FRAME;
+    gps->readFrame = GPS_NO_FRAME;
+    gps->oversizeFrames = 0;
+    memset(gps->subscriptions, 0, sizeof(gps->subscriptions));
+    NMEAPARSER_init(&gps->nmea, NULL, NULL);
+
+    gps->commandHead = 0;
+    gps->commandTail = 0;
+    gps->commandState = GPS_CMD_IDLE_ST;
+    gps->commandsOk = 0;
+    gps->commandsFailed = 0;
+    gps->replyLength = GPS_NO_REPLY;
+    gps->replyCount = 0;
+
+    gps->setBaudRate = NULL;
+    gps->baudContext = NULL;
+    gps->baudState = GPS_BAUD_IDLE_ST;
+    gps->baudRate = 0;
+    NOVATELGPS_setLineRate(gps, interface->Init.BaudRate);
+
+    // Only queued here, they go out from NOVATELGPS_poll once reception is running
 
     // GPS position should be set approximately (hard coded to LARA/UnB coordinates)
-    NOVATELGPS_command(gps, "SETAPPROXPOS -15.765824 -47.872109 1024");
+    NOVATELGPS_command(gps, "SETAPPROXPOS -15.765824 -47.872109 1024", NULL, NULL);
 
-    // char buf[100];
-    // double time_f = static_cast<double>(1.0/rate_);
-    // sprintf(buf, "LOG BESTXYZB ONTIME 0.05");
-    NOVATELGPS_command(gps, "LOG BESTXYZB ONTIME 0.05");
+    NOVATELGPS_command(gps, "LOG BESTXYZB ONTIME 0.05", NULL, NULL);
 }
 
-void NOVATELGPS_geData(NovatelGPS* gps)
+void NOVATELGPS_setFrameCallback(NovatelGPS* gps, NovatelFrameCallback callback, void* context)
+{
+    gps->callbackContext = context;
+    gps->frameCallback = callback;
+}
+
+void NOVATELGPS_setTimeCallback(NovatelGPS* gps, NovatelTimeCallback callback, void* context)
+{
+    gps->timeContext = context;
+    gps->timeCallback = callback;
+}
+
+void NOVATELGPS_setNmeaCallback(NovatelGPS* gps, NMEASentenceCallback callback, void* context)
+{
+    // The parser already runs, its state and counters are kept
+    gps->nmea.callbackContext = context;
+    gps->nmea.callback = callback;
+}
+
+int8_t NOVATELGPS_subscribe(NovatelGPS* gps, uint16_t messageId, NovatelFrameCallback callback, void* context)
+{
+    // Open addressing: start at the id's hash slot, take it or the next free one
+    for(uint16_t i = 0; i < GPS_SUBSCRIPTIONS; i++)
+    {
+        NovatelSubscription* slot = &gps->subscriptions[(messageId + i) & (GPS_SUBSCRIPTIONS - 1)];
+
+        if((slot->callback == NULL) || (slot->messageId == messageId))
+        {
+            slot->context = context;
+            slot->messageId = messageId;
+            slot->callback = callback;
+            return 1;
+        }
+    }
+
+    // Table full
+    return 0;
+}
+
+void NOVATELGPS_pushBytes(NovatelGPS* gps, const uint8_t* buffer, uint32_t length)
+{
+    NOVATELGPS_pushBytesAt(gps, buffer, length, 0);
+}
+
+void NOVATELGPS_pushBytesAt(NovatelGPS* gps, const uint8_t* buffer, uint32_t length, uint64_t lastByteTime)
+{
+    for(uint32_t i = 0; i < length; i++)
+    {
+        // Frame time is its first sync byte: the span end moved back by one
+        // character time per byte still to come in the span
+        if((gps->s == GPS_SYNC_ST) && (gps->b == SYNC0) && (buffer[i] == D_SYNC0))
+        {
+            if(lastByteTime != 0)
+                gps->frameTime = lastByteTime - ((length - 1 - i) * gps->byteTimeNs) / 1000;
+            else
+                gps->frameTime = 0;
+        }
+
+        // Mixed-mode port: NMEA sentences can only start between binary
+        // frames, and any byte of a binary sync (0xAA) drops a sentence.
+        // Parsed with or without a callback, its sentences also prove the
+        // baud rate
+        if(gps->s == GPS_SYNC_ST)
+        {
+            NMEAPARSER_parseByte(&gps->nmea, buffer[i]);
+            NOVATELGPS_parseReply(gps, buffer[i]);
+        }
+
+        NOVATELGPS_frameByte(gps, buffer[i]);
+    }
+}
+
+const NovatelFrame* NOVATELGPS_acquireFrame(NovatelGPS* gps)
 {
-    int data_ready = 0;
-    // State machine variables
-    int b = 0, bb = 0, s = GPS_SYNC_ST;
+    uint8_t latest;
+
+    // Single consumer. Claim the latest frame, then make sure it was not
+    // replaced meanwhile: until the claim is visible the framer may pick it
+    // to write into. Once claimed it stays untouched until the next call
+    do
+    {
+        latest = gps->latestFrame;
+        gps->readFrame = latest;
+    }
+    while(gps->latestFrame != latest);
+
+    if(latest == GPS_NO_FRAME)
+        return NULL;
+
+    return &gps->frames[latest];
+}
 
+void NOVATELGPS_lineError(NovatelGPS* gps, uint32_t error)
+{
+    gps->lineError = error;
+    gps->lineErrors++;
+
+    // Bytes were lost with the error, the frame in progress cannot pass its
+    // CRC: drop it and hunt for the next sync
+    gps->bytesDiscarded += gps->b + gps->bb;
+    gps->recovering = 0;
+    gps->bb = 0;
+    gps->b = 0;
+    gps->s = GPS_SYNC_ST;
+}
+
+void NOVATELGPS_geData(NovatelGPS* gps)
+{
     // Storage for data read from serial port
     uint8_t data_read;
-    uint8_t* gps_data = gps->messageData;
-
-    // Multi-byte data
-    uint16_t msg_id, msg_len = 0, t_week;
-    uint32_t t_ms, crc_from_packet;
+    uint32_t frame_count = gps->frameCount;
 
     // Try to sync with GPS and get latest data packet, up to MAX_BYTES read until failure
-    for(int i = 0; (!data_ready)&&(i < MAX_BYTES); i++)
+    for(int i = 0; (gps->frameCount == frame_count)&&(i < MAX_BYTES); i++)
     {
         // Read data from UART
         if(HAL_UART_Receive(gps->UARTInterface, &data_read, BYTE_SIZE_2READ, timeout) != HAL_OK)
@@ -123,460 +289,625 @@ void NOVATELGPS_geData(NovatelGPS* gps)
             Error_Handler();
         }
 
+        NOVATELGPS_pushBytes(gps, &data_read, 1);
+    }
+}
 
-        // Parse GPS packet (Firmware Reference Manual, p.22)
-        switch(s)
-        {
-            case GPS_SYNC_ST:
-            {
-                // State logic: Packet starts with 3 sync bytes with values 0xAA, 0x44, 0x12
-                switch(b)
-                {
-                    case SYNC0:
-                    {
-                        if(data_read == D_SYNC0)
-                        {
-                            gps_data[b] = data_read;
-                            b++;
-                        }
-                        else
-                            // Out of sync, reset
-                            b = 0;
-                        break;
-                    }
+static void NOVATELGPS_frameByte(NovatelGPS* gps, uint8_t data_read)
+{
+    uint16_t held = NOVATELGPS_parseByte(gps, data_read);
 
-                    case SYNC1:
-                    {
-                        if(data_read == D_SYNC1)
-                        {
-                            gps_data[b] = data_read;
-                            b++;
-                        }
-                        else
-                            // Out of sync, reset
-                            b = 0;
-                        break;
-                    }
+    // Rejected frame: the next one may start inside its bytes, replay them
+    // from the next sync. In place, a replayed byte is never written past the
+    // one being read (a frame completed meanwhile moves on to another buffer)
+    while(held > 0)
+    {
+        uint8_t* data = gps->frameData[gps->writeFrame];
+        uint64_t dataTime = gps->frameTime;
+        uint16_t start = NOVATELGPS_findSync(data, held);
+        uint16_t i, failed = 0;
 
-                    case SYNC2:
-                    {
-                        if(data_read == D_SYNC2)
-                        {
-                            gps_data[b] = data_read;
-                            b++;
-                        }
-                        else
-                            // Out of sync, reset
-                            b = 0;
-                        break;
-                    }
-                }
-                // State transition: I have reached the HDR_LEN byte without resetting
-                if(b == HDR_LEN)
-                    s = GPS_HEADER_ST;
-            }
+        gps->bytesDiscarded += start;
+        if(start == held)
             break;
 
-            case GPS_HEADER_ST:
-            {
-                // State logic: HDR_LEN, MSG_ID, MSG_TYPE, PORT_ADDR, MSG_LEN, SEQ_NUM, IDLE_T, T_STATUS, T_WEEK, T_MS, GPS_STATUS, RESERVED, SW_VERS
-                switch(b)
-                {
-                    case HDR_LEN:
-                    {
-                        if(data_read == D_HDR_LEN)
-                        {
-                            gps_data[b] = data_read;
-                            b++;
-                        }
-                        else
-                        {
-                            // Invalid HDR_LEN, reset
-                            Error_Handler();
-                            b = 0;
-                            s = GPS_SYNC_ST;
-                        }
-                        break;
-                    }
-
-                    case MSG_ID:
-                    {
-                        // Index bb is for bytes in multi-byte variables
-                        gps_data[b+bb] = data_read;
-                        bb++;
-
-                        if(bb == S_MSG_ID)
-                        {
-                            // Merge bytes and process
-                            memcpy(&msg_id, &gps_data[MSG_ID], sizeof(uint16_t));
-
-                            // Update byte indices
-                            bb = 0;
-                            b += S_MSG_ID;
-                        }
-                        break;
-                    }
-
-                    case MSG_TYPE:
-                    {
-                        gps_data[b] = data_read;
-                        b++;
-                        break;
-                    }
-
-                    case PORT_ADDR:
-                    {
-                        gps_data[b] = data_read;
-                        b++;
-                        break;
-                    }
+        gps->recovering = 1;
+        for(i = start; (i < held) && (failed == 0); i++)
+        {
+            // Replayed frames are dated from their offset in the rejected one
+            if((gps->s == GPS_SYNC_ST) && (gps->b == SYNC0) && (data[i] == D_SYNC0) && (dataTime != 0))
+                gps->frameTime = dataTime + ((uint32_t)i * gps->byteTimeNs) / 1000;
 
-                    case MSG_LEN:
-                    {
-                        // Index bb is for bytes in multi-byte variables
-                        gps_data[b+bb] = data_read;
-                        bb++;
-
-                        if(bb == S_MSG_LEN)
-                        {
-                            // Merge bytes and process
-                            memcpy(&msg_len, &gps_data[MSG_LEN], sizeof(uint16_t));
-                            // ROS_INFO("Message Length = %d", msg_len);
-                            // I was having some problems with (msg_len == 0)...
-                            if(msg_len != 0)
-                            {
-                                // Update byte indices
-                                bb = 0;
-                                b += S_MSG_LEN;
-                            }
-                            else
-                            {
-                                // Something wrong, reset
-                                bb = 0;
-                                b = 0;
-                                s = GPS_SYNC_ST;
-                            }
-                        }
-                        break;
-                    }
+            failed = NOVATELGPS_parseByte(gps, data[i]);
+        }
 
-                    case SEQ_NUM:
-                    {
-                        // Index bb is for bytes in multi-byte variables
-                        gps_data[b+bb] = data_read;
-                        bb++;
-
-                        if(bb == S_SEQ_NUM)
-                        {
-                            // Merge bytes and process
-                            //memcpy(&seq_num, &gps_data[SEQ_NUM], sizeof(uint16_t));
-
-                            // Update byte indices
-                            bb = 0;
-                            b += S_SEQ_NUM;
-                        }
-                        break;
-                    }
+        // Rejected again: its bytes are at the start of the write buffer, the
+        // ones not replayed yet go right after them
+        memmove(gps->frameData[gps->writeFrame] + failed, &data[i], held - i);
+        held = failed + (held - i);
+        if(failed == 0)
+            break;
+    }
+}
 
-                    case IDLE_T:
+// Returns 0, or for a rejected frame the number of its bytes left in the
+// write buffer (all of them, or only the header if the payload was skipped)
+static uint16_t NOVATELGPS_parseByte(NovatelGPS* gps, uint8_t data_read)
+{
+    uint8_t* gps_data = gps->frameData[gps->writeFrame];
+    uint16_t held = 0;
+
+    // CRC covers every byte from the first sync byte up to the CRC itself,
+    // so it is updated here and the CRC state only has to compare
+    if((gps->s == GPS_SYNC_ST) && (gps->b == SYNC0))
+        gps->crc = NOVATEL_CRC_INIT;
+    if(gps->s != GPS_CRC_ST)
+        gps->crc = NOVATELCRC_update(gps->crc, data_read);
+
+    // Parse GPS packet (Firmware Reference Manual, p.22)
+    switch(gps->s)
+    {
+        case GPS_SYNC_ST:
+        {
+            // State logic: Packet starts with 3 sync bytes with values 0xAA, 0x44, 0x12
+            switch(gps->b)
+            {
+                case SYNC0:
+                {
+                    if(data_read == D_SYNC0)
                     {
-                        gps_data[b] = data_read;
-                        b++;
-                        break;
+                        gps_data[gps->b] = data_read;
+                        gps->b++;
                     }
+                    else
+                        // Out of sync, reset
+                        gps->b = 0;
+                    break;
+                }
 
-                    case T_STATUS:
+                case SYNC1:
+                {
+                    gps_data[gps->b] = data_read;
+                    if(data_read == D_SYNC1)
                     {
-                        gps_data[b] = data_read;
-                        b++;
-                        break;
+                        gps->b++;
                     }
-
-                    case T_WEEK:
+                    else
                     {
-                        // Index bb is for bytes in multi-byte variables
-                        gps_data[b+bb] = data_read;
-                        bb++;
-
-                        if(bb == S_T_WEEK)
-                        {
-                            // Merge bytes and process
-                            memcpy(&t_week, &gps_data[T_WEEK], sizeof(uint16_t));
-
-                            // Update byte indices
-                            bb = 0;
-                            b += S_T_WEEK;
-                        }
-                        break;
+                        // Out of sync, reset (the byte may be a new sync)
+                        held = gps->b + 1;
+                        gps->b = 0;
                     }
+                    break;
+                }
 
-                    case T_MS:
+                case SYNC2:
+                {
+                    // Third sync byte selects the long or the short header
+                    gps_data[gps->b] = data_read;
+                    if((data_read == D_SYNC2) || (data_read == D_SYNC2_SHORT))
                     {
-                        // Index bb is for bytes in multi-byte variables
-                        gps_data[b+bb] = data_read;
-                        bb++;
-
-                        if(bb == S_T_MS)
-                        {
-                            // Merge bytes and process
-                            memcpy(&t_ms, &gps_data[T_MS], sizeof(uint32_t));
-
-                            // Update byte indices
-                            bb = 0;
-                            b += S_T_MS;
-                        }
-                        break;
+                        gps->headerSize = (data_read == D_SYNC2) ? D_HDR_LEN : D_SHORT_HDR_LEN;
+                        gps->b++;
                     }
-
-                    case GPS_STATUS:
+                    else
                     {
-                        // Index bb is for bytes in multi-byte variables
-                        gps_data[b+bb] = data_read;
-                        bb++;
-
-                        if(bb == S_GPS_STATUS)
-                        {
-                            // Merge bytes and process
-                            memcpy(&(gps->status), &gps_data[GPS_STATUS], sizeof(uint32_t));
-
-                            // Update byte indices
-                            bb = 0;
-                            b += S_GPS_STATUS;
-                        }
-                        break;
+                        // Out of sync, reset (the byte may be a new sync)
+                        held = gps->b + 1;
+                        gps->b = 0;
                     }
+                    break;
+                }
+            }
+            // State transition: I have reached the HDR_LEN byte without resetting
+            if(gps->b == HDR_LEN)
+                gps->s = GPS_HEADER_ST;
+        }
+        break;
 
-                    case RESERVED:
-                    {   
-                        // Index bb is for bytes in multi-byte variables
-                        // Skip this section, no useful data
-                        bb++;
-
-                        if(bb == S_RESERVED)
-                        {
-                            // Update byte indices
-                            bb = 0;
-                            b += S_RESERVED;
-                        }
-                        break;
-                    }
+        case GPS_HEADER_ST:
+        {
+            // State logic: Collect the whole header, its layout depends on the third sync byte
+            gps_data[gps->b] = data_read;
+            gps->b++;
 
-                    case SW_VERS:
-                    {
-                        // Index bb is for bytes in multi-byte variables
-                        gps_data[b+bb] = data_read;
-                        bb++;
-
-                        if(bb == S_SW_VERS)
-                        {
-                            // Merge bytes and process
-                            //memcpy(&sw_vers, &gps_data[SW_VERS], sizeof(uint16_t));
-
-                            // Update byte indices
-                            bb = 0;
-                            b += S_SW_VERS;
-                        }
-                        break;
-                    }
+            // State transition: I have reached the DATA bytes
+            if(gps->b == gps->headerSize)
+            {
+                if(NOVATELGPS_decodeHeader(gps))
+                {
+                    gps->s = GPS_PAYLOAD_ST;
+                }
+                else
+                {
+                    // Invalid header, reset
+                    held = gps->b;
+                    gps->b = 0;
+                    gps->s = GPS_SYNC_ST;
                 }
-
-                // State transition: I have reached the DATA bytes without resetting
-                if(b == DATA)
-                    s = GPS_PAYLOAD_ST;  
             }
-            break;
+        }
+        break;
 
-            case GPS_PAYLOAD_ST:
+        case GPS_PAYLOAD_ST:
+        {
+            // State logic: Grab data until you reach the CRC bytes (skipped
+            // payloads only advance the CRC)
+            if(gps->store)
+                gps_data[gps->b+gps->bb] = data_read;
+            gps->bb++;
+
+            // State transition: I have reached the CRC bytes
+            if(gps->bb == gps->msg_len)
             {
-                // State logic: Grab data until you reach the CRC bytes
-                gps_data[b+bb] = data_read;
-                bb++;
+                // Bytes are decoded after CRC check
 
-                // State transition: I have reached the CRC bytes
-                if(bb == msg_len)
-                {
-                    // Bytes are decoded after CRC check
-
-                    // Update byte indices
-                    bb = 0;
-                    b += msg_len;
-                    s = GPS_CRC_ST;
-                }
+                // Update byte indices
+                gps->bb = 0;
+                gps->b += gps->msg_len;
+                gps->s = GPS_CRC_ST;
             }
-            break;
+        }
+        break;
 
-            case GPS_CRC_ST:
+        case GPS_CRC_ST:
+        {
+            // Index bb is for bytes in multi-byte variables. Grab CRC from
+            // packet (sent little-endian), kept only for a rescan
+            if(gps->store)
+                gps_data[gps->b+gps->bb] = data_read;
+            if(gps->bb == 0)
+                gps->crc_from_packet = 0;
+            gps->crc_from_packet |= (uint32_t)data_read << (8*gps->bb);
+            gps->bb++;
+            if(gps->bb == S_CRC)
             {
-                // Index bb is for bytes in multi-byte variables
-                gps_data[b+bb] = data_read;
-                bb++;
-                if(bb == S_CRC)
+                // Compare with the CRC accumulated while receiving to see if valid packet
+                if(gps->crc_from_packet == gps->crc)
                 {
-                    uint32_t crc_calculated;
-                    // Grab CRC from packet
-                    crc_from_packet = (uint32_t)((gps_data[b+3] << 24) | (gps_data[b+2] << 16) | (gps_data[b+1] << 8) | gps_data[b]);
+                    // b = packet size
+                    gps->messageSize = gps->b + S_CRC;
+                    gps->frameCount++;
 
-                    // Calculate CRC from packet (b = packet size)
-                    // crc_calculated = CalculateBlockCRC32(b, &gps_data[0]); // GAMBIARRA
-                    crc_calculated = CalculateBlockCRC32(b, gps_data);
-                    // crc_calculated = CalculateBlockCRC32(b, gps_data.data()); // C++11
+                    if(gps->recovering)
+                        gps->framesRecovered++;
 
-                    // Compare them to see if valid packet 
-                    if(crc_from_packet != ByteSwap(crc_calculated))
-                    {
-                        // ROS_ERROR("CRC does not match (%0x != %0x)", crc_from_packet, ByteSwap(crc_calculated));
-                    }
-                    // decode(msg_id);
-                    data_ready = 1;
+                    // Every log dates itself, not only the decoded ones
+                    if(gps->timeCallback != NULL)
+                        gps->timeCallback(gps->t_week, gps->t_ms, gps->frameTime, gps->timeContext);
 
-                    // State transition: Unconditional reset
-                    bb = 0;
-                    b = 0;
-                    s = GPS_SYNC_ST;
+                    // Skipped payloads are only counted, there is nothing to deliver
+                    if(gps->store)
+                        NOVATELGPS_publishFrame(gps);
                 }
+                else if(gps->store)
+                {
+                    held = gps->b + S_CRC;
+                }
+                else
+                {
+                    // Skipped payload: only its header is in the buffer to
+                    // rescan, the rest is gone
+                    held = gps->headerSize;
+                    gps->bytesDiscarded += gps->msg_len + S_CRC;
+                }
+
+                // State transition: Unconditional reset
+                gps->recovering = 0;
+                gps->bb = 0;
+                gps->b = 0;
+                gps->s = GPS_SYNC_ST;
             }
-            break;
         }
+        break;
+    }
+
+    // A rejected frame is over, its rescan starts a new one
+    if(held != 0)
+        gps->recovering = 0;
+
+    return held;
+}
+
+// First offset after the first byte that may start a frame: a full sync, or
+// the part of one that the data ends with. Returns length if there is none
+static uint16_t NOVATELGPS_findSync(const uint8_t* data, uint16_t length)
+{
+    const uint8_t* p = data + 1;
+    const uint8_t* end = data + length;
+
+    // memchr is word-wide in newlib, frames are mostly not 0xAA
+    while((p < end) && ((p = memchr(p, D_SYNC0, end - p)) != NULL))
+    {
+        if(((p + 1 >= end) || (p[1] == D_SYNC1)) &&
+           ((p + 2 >= end) || (p[2] == D_SYNC2) || (p[2] == D_SYNC2_SHORT)))
+            return p - data;
+        p++;
     }
 
-    // b = packet size
-    gps->messageSize = b;
+    return length;
 }
 
-void NOVATELGPS_configure(NovatelGPS* gps)
+static int8_t NOVATELGPS_decodeHeader(NovatelGPS* gps)
 {
-    // GPS should be configured to 9600 and change to 115200 during execution
-    char buffer[100];
-    // sprintf(buffer, "COM COM1,%d,N,8,1,N,OFF,ON", OLD_BPS);
-    // sprintf(buffer, "COM COM1,%d,N,8,1,N,OFF,ON", BPS);
-    // command(buffer);
-    // command("COM COM2,115200,N,8,1,N,OFF,ON");
-
-    uint32_t gps_week_1024, gps_secs;
-    // GPS time should be set approximately
-    if(!NOVATELGPS_getApproxTime(&gps_week_1024, &gps_secs))
+    const uint8_t* gps_data = gps->frameData[gps->writeFrame];
+
+    if(gps->headerSize == D_HDR_LEN)
     {
-        Error_Handler();
+        // Long header: HDR_LEN, MSG_ID, MSG_TYPE, PORT_ADDR, MSG_LEN, SEQ_NUM, IDLE_T, T_STATUS, T_WEEK, T_MS, GPS_STATUS, RESERVED, SW_VERS
+        if(gps_data[HDR_LEN] != D_HDR_LEN)
+            return 0;
+
+        gps->msg_id = NOVATEL_getU16(&gps_data[MSG_ID]);
+        gps->msg_len = NOVATEL_getU16(&gps_data[MSG_LEN]);
+        gps->t_week = NOVATEL_getU16(&gps_data[T_WEEK]);
+        gps->t_ms = NOVATEL_getU32(&gps_data[T_MS]);
+        gps->status = NOVATEL_getU32(&gps_data[GPS_STATUS]);
     }
     else
     {
-        // sprintf(buffer, "SETAPPROXTIME %lu %f", gps_week_1024, gps_secs);
-        NOVATELGPS_command(gps, buffer);
+        // Short header: MSG_LEN, MSG_ID, T_WEEK, T_MS (no receiver status)
+        gps->msg_len = gps_data[SH_MSG_LEN];
+        gps->msg_id = NOVATEL_getU16(&gps_data[SH_MSG_ID]);
+        gps->t_week = NOVATEL_getU16(&gps_data[SH_T_WEEK]);
+        gps->t_ms = NOVATEL_getU32(&gps_data[SH_T_MS]);
     }
 
-    // GPS position should be set approximately (hard coded to LARA/UnB coordinates)
-    NOVATELGPS_command(gps, "SETAPPROXPOS -15.765824 -47.872109 1024");
-    // command("SETAPPROXPOS -15.791372 -48.0227546 1178");
+    // I was having some problems with (msg_len == 0)...
+    if(gps->msg_len == 0)
+        return 0;
+
+    // Payloads nobody listens to are skipped: only the CRC advances, nothing
+    // is written to the buffer
+    gps->subscription = NOVATELGPS_lookup(gps, gps->msg_id);
+    gps->store = (gps->subscription != NULL) || (gps->frameCallback != NULL);
+
+    // Frames that do not fit the buffer are rejected here, before the first
+    // payload byte: they are followed to their CRC but never stored
+    if(gps->store && (gps->headerSize + gps->msg_len + S_CRC > GPS_PACKET_SIZE))
+    {
+        gps->oversizeFrames++;
+        gps->store = 0;
+    }
+
+    return 1;
 }
 
-void NOVATELGPS_command(NovatelGPS* gps, const char* command)
+static void NOVATELGPS_publishFrame(NovatelGPS* gps)
 {
-    int32_t i;
-    int32_t len = strlen(command);
-
-    for(i = 0; i < len; i++)
+    uint8_t write = gps->writeFrame;
+    NovatelFrame* frame = &gps->frames[write];
+
+    frame->data = gps->frameData[write];
+    frame->headerSize = gps->headerSize;
+    frame->messageId = gps->msg_id;
+    frame->messageSize = gps->msg_len;
+    frame->week = gps->t_week;
+    frame->milliseconds = gps->t_ms;
+    frame->sequence = gps->frameCount;
+    frame->localTime = gps->frameTime;
+
+    // decode(msg_id)
+    if(gps->subscription != NULL)
+        gps->subscription->callback(frame, gps->subscription->context);
+
+    if(gps->frameCallback != NULL)
+        gps->frameCallback(frame, gps->callbackContext);
+
+    // Publish, then carry on in a buffer that is neither the latest nor the
+    // consumer's (with 3 buffers there is always one)
+    gps->latestFrame = write;
+
+    for(uint8_t i = 0; i < GPS_FRAME_BUFFERS; i++)
     {
-        if(HAL_UART_Transmit(gps->UARTInterface, (uint8_t*) &command[i], BYTE_SIZE_2SEND, timeout) != HAL_OK)
+        if((i != write) && (i != gps->readFrame))
         {
-            Error_Handler();
+            gps->writeFrame = i;
+            break;
         }
-        HAL_Delay(5);
+    }
+}
+
+static const NovatelSubscription* NOVATELGPS_lookup(NovatelGPS* gps, uint16_t msg_id)
+{
+    // Probes are bounded by the table size, which is a compile-time constant
+    for(uint16_t i = 0; i < GPS_SUBSCRIPTIONS; i++)
+    {
+        const NovatelSubscription* slot = &gps->subscriptions[(msg_id + i) & (GPS_SUBSCRIPTIONS - 1)];
+
+        if(slot->callback == NULL)
+            return NULL;
+        if(slot->messageId == msg_id)
+            return slot;
     }
 
-    // Sending Carriage Return character
-    if(HAL_UART_Transmit(gps->UARTInterface, (uint8_t*) "\r", BYTE_SIZE_2SEND, timeout) != HAL_OK)
+    return NULL;
+}
+
+int8_t NOVATELGPS_command(NovatelGPS* gps, const char* command, NovatelCommandCallback callback, void* context)
+{
+    uint8_t tail = gps->commandTail;
+    uint8_t next = (tail + 1) & (GPS_COMMANDS - 1);
+    uint32_t len = strlen(command);
+    NovatelCommand* slot = &gps->commands[tail];
+
+    // Queue full or command too long
+    if((next == gps->commandHead) || (len + 2 > GPS_COMMAND_SIZE))
+        return 0;
+
+    // Whole line is sent in one transfer, terminated by CR LF
+    memcpy(slot->text, command, len);
+    slot->text[len] = '\r';
+    slot->text[len + 1] = '\n';
+    slot->length = len + 2;
+    slot->callback = callback;
+    slot->context = context;
+
+    // Single producer (the configuring task): publishing the tail is enough
+    gps->commandTail = next;
+
+    return 1;
+}
+
+void NOVATELGPS_txComplete(NovatelGPS* gps)
+{
+    // Line sent, the receiver answers once it has processed it
+    if(gps->commandState == GPS_CMD_SENDING_ST)
+        gps->commandState = GPS_CMD_WAITING_ST;
+}
+
+void NOVATELGPS_poll(NovatelGPS* gps)
+{
+    // Queued commands wait until the link rate is settled
+    if(gps->baudState != GPS_BAUD_IDLE_ST)
     {
-        Error_Handler();
+        NOVATELGPS_stepBaudRate(gps);
+        return;
     }
-    HAL_Delay(5);
 
-    // Sending Line Feed character
-    if(HAL_UART_Transmit(gps->UARTInterface, (uint8_t*) "\n", BYTE_SIZE_2SEND, timeout) != HAL_OK)
+    // Replies and transfer completions advance the queue from interrupts,
+    // keep them out while starting a command or timing one out
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if(gps->commandState == GPS_CMD_IDLE_ST)
     {
-        Error_Handler();
+        NOVATELGPS_sendCommand(gps);
     }
-    HAL_Delay(5);
+    else if((HAL_GetTick() - gps->commandTick) > GPS_COMMAND_TIMEOUT)
+    {
+        NOVATELGPS_finishCommand(gps, GPS_CMD_TIMEOUT);
+        NOVATELGPS_sendCommand(gps);
+    }
+
+    __set_PRIMASK(primask);
 }
 
-// Calculate GPS week number and seconds, within 10 minutes of actual time, for initialization
-int8_t NOVATELGPS_getApproxTime(uint32_t* gps_week_1024, uint32_t* gps_secs)
+static void NOVATELGPS_parseReply(NovatelGPS* gps, uint8_t data_read)
 {
-    // Time difference between January 1, 1970 and January 6, 1980
-    // Source: http://www.timeanddate.com/date/durationresult.html?d1=1&m1=jan&y1=1970&h1=0&i1=0&s1=0&d2=6&m2=jan&y2=1980&h2=0&i2=0&s2=0
-    const uint32_t time_diff = 315964800;
-
-    // # of seconds in a week
-    const uint32_t secs_in_week = 604800;
+    // Abbreviated ASCII replies: "<OK" or "<ERROR:<text>", one per line
+    if(data_read == '<')
+    {
+        gps->replyLength = 0;
+        return;
+    }
 
-    // Unix time
-    time_t cpu_secs = 0;
+    if(gps->replyLength == GPS_NO_REPLY)
+        return;
 
-    // Unprocessed GPS time
-    uint32_t gps_time;
-    uint32_t gps_week;
+    if((data_read != '\r') && (data_read != '\n') && (data_read != ':') && (gps->replyLength < GPS_REPLY_SIZE))
+    {
+        gps->reply[gps->replyLength++] = data_read;
+        return;
+    }
 
-    // Get time
-    // cpu_secs = time(NULL);
+    // Keyword complete: anything else starting with '<' is an ASCII log
+    if((gps->replyLength == 2) && (memcmp(gps->reply, "OK", 2) == 0))
+    {
+        gps->replyCount++;
+        if(gps->commandState != GPS_CMD_IDLE_ST)
+        {
+            NOVATELGPS_finishCommand(gps, GPS_CMD_OK);
+            NOVATELGPS_sendCommand(gps);
+        }
+    }
+    else if((gps->replyLength == 5) && (memcmp(gps->reply, "ERROR", 5) == 0))
+    {
+        gps->replyCount++;
+        if(gps->commandState != GPS_CMD_IDLE_ST)
+        {
+            NOVATELGPS_finishCommand(gps, GPS_CMD_ERROR);
+            NOVATELGPS_sendCommand(gps);
+        }
+    }
 
-    // Offset to GPS time and calculate weeks and seconds
-    gps_time = cpu_secs - time_diff;
-    gps_week = gps_time / secs_in_week;
-    *gps_week_1024 = gps_week % 1024;
-    *gps_secs = gps_time % secs_in_week;
+    gps->replyLength = GPS_NO_REPLY;
+}
 
-    if((gps_week != 0) && (*gps_secs != 0))
-        return 1;
-    else
+int8_t NOVATELGPS_negotiateBaudRate(NovatelGPS* gps, uint32_t target, NovatelBaudCallback setBaudRate, void* context)
+{
+    // Bring-up only: nothing may be on the line yet
+    if((gps->commandState != GPS_CMD_IDLE_ST) || (gps->baudState != GPS_BAUD_IDLE_ST))
         return 0;
+
+    gps->setBaudRate = setBaudRate;
+    gps->baudContext = context;
+    gps->baudTarget = target;
+    gps->baudRate = 0;
+    gps->baudIndex = 0;
+
+    // Steps run from NOVATELGPS_poll
+    gps->baudState = GPS_BAUD_PROBE_ST;
+    NOVATELGPS_probeBaudRate(gps, NOVATELGPS_baudRates[0]);
+
+    return 1;
 }
 
-/*************************** CRC functions (Firmware Reference Manual, p.32 + APN-030 Rev 1 Application Note) ***************************/
+static void NOVATELGPS_stepBaudRate(NovatelGPS* gps)
+{
+    uint32_t elapsed = HAL_GetTick() - gps->baudTick;
+    uint8_t synced = (NOVATELGPS_syncEvents(gps) != gps->syncEvents);
+
+    switch(gps->baudState)
+    {
+        case GPS_BAUD_PROBE_ST:
+        {
+            if(synced)
+            {
+                gps->baudRate = NOVATELGPS_baudRates[gps->baudIndex];
+
+                if(gps->baudRate >= gps->baudTarget)
+                {
+                    gps->baudState = GPS_BAUD_IDLE_ST;
+                    break;
+                }
 
-inline uint32_t ByteSwap (uint32_t n)
-{ 
-   return ( ((n & 0x000000FF)<<24) + ((n & 0x0000FF00)<<8) + ((n & 0x00FF0000)>>8) + (( n & 0xFF000000)>>24) );
+                // Receiver found below the target, ask it to switch (the reply
+                // may come at either rate, it is not waited for)
+                char* end = gps->baudCommand;
+
+                end = NOVATELGPS_putText(end, "\r\nCOM " GPS_COM_PORT ",");
+                end = NOVATELGPS_putDecimal(end, gps->baudTarget);
+                end = NOVATELGPS_putText(end, ",N,8,1,N,OFF,ON\r\n");
+                HAL_UART_Transmit_IT(gps->UARTInterface, (uint8_t*) gps->baudCommand, end - gps->baudCommand);
+                gps->baudTick = HAL_GetTick();
+                gps->baudState = GPS_BAUD_SWITCH_ST;
+            }
+            else if(elapsed > GPS_BAUD_PROBE_TIME)
+            {
+                gps->baudIndex++;
+
+                if(gps->baudIndex == GPS_BAUD_RATES)
+                {
+                    // Nothing answered: back to the default rate, baudRate stays 0
+                    NOVATELGPS_setLineRate(gps, NOVATELGPS_baudRates[0]);
+                    gps->baudState = GPS_BAUD_IDLE_ST;
+                    break;
+                }
+
+                NOVATELGPS_probeBaudRate(gps, NOVATELGPS_baudRates[gps->baudIndex]);
+            }
+        }
+        break;
+
+        case GPS_BAUD_SWITCH_ST:
+        {
+            // COM command must have left the shift register before our side changes
+            if((gps->UARTInterface->gState != HAL_UART_STATE_READY) || (elapsed < GPS_BAUD_SETTLE_TIME))
+                break;
+
+            NOVATELGPS_probeBaudRate(gps, gps->baudTarget);
+            gps->baudState = GPS_BAUD_VERIFY_ST;
+        }
+        break;
+
+        case GPS_BAUD_VERIFY_ST:
+        {
+            if(synced)
+            {
+                gps->baudRate = gps->baudTarget;
+                gps->baudState = GPS_BAUD_IDLE_ST;
+            }
+            else if(elapsed > GPS_BAUD_PROBE_TIME)
+            {
+                // New rate did not sync: scan again for wherever the receiver
+                // ended up, without trying to raise it a second time
+                gps->baudTarget = 0;
+                gps->baudRate = 0;
+                gps->baudIndex = 0;
+                NOVATELGPS_probeBaudRate(gps, NOVATELGPS_baudRates[0]);
+                gps->baudState = GPS_BAUD_PROBE_ST;
+            }
+        }
+        break;
+    }
 }
 
-#define CRC32_POLYNOMIAL    0xEDB88320L
+static void NOVATELGPS_probeBaudRate(NovatelGPS* gps, uint32_t baudRate)
+{
+    NOVATELGPS_setLineRate(gps, baudRate);
+
+    gps->syncEvents = NOVATELGPS_syncEvents(gps);
+    gps->baudTick = HAL_GetTick();
+
+    // A refused transfer only costs this rate its probe, the window still runs
+    HAL_UART_Transmit_IT(gps->UARTInterface, (uint8_t*) NOVATELGPS_probe, sizeof(NOVATELGPS_probe) - 1);
+}
+
+static void NOVATELGPS_setLineRate(NovatelGPS* gps, uint32_t baudRate)
+{
+    if(gps->setBaudRate != NULL)
+        gps->setBaudRate(baudRate, gps->baudContext);
+
+    // 8N1: 10 bit times per character
+    gps->lineRate = baudRate;
+    gps->byteTimeNs = (baudRate != 0) ? (10000000000ULL / baudRate) : 0;
+}
+
+static char* NOVATELGPS_putText(char* out, const char* text)
+{
+    uint32_t len = strlen(text);
+
+    memcpy(out, text, len);
+    return out + len;
+}
 
-/* --------------------------------------------------------------------------
-Calculate a CRC value to be used by CRC calculation functions.
--------------------------------------------------------------------------- */
-inline uint32_t CRC32Value(int i)
+static char* NOVATELGPS_putDecimal(char* out, uint32_t value)
 {
-    int j;
-    uint32_t ulCRC;
-    ulCRC = i;
+    // No printf on the task stack: digits come out least significant first
+    char digits[10];
+    uint8_t count = 0;
 
-    for ( j = 8 ; j > 0; j-- )
+    do
     {
-        if ( ulCRC & 1 )
-            ulCRC = ( ulCRC >> 1 ) ^ CRC32_POLYNOMIAL;
-        else
-            ulCRC >>= 1;
+        digits[count++] = '0' + (value % 10);
+        value /= 10;
     }
-    return ulCRC;
+    while(value != 0);
+
+    while(count != 0)
+        *out++ = digits[--count];
+
+    return out;
 }
 
-/* --------------------------------------------------------------------------
-Calculates the CRC-32 of a block of data all at once
--------------------------------------------------------------------------- */
-inline uint32_t CalculateBlockCRC32
-(
-    uint32_t ulCount,  /* Number of bytes in the data block */
-    uint8_t *ucBuffer /* Data block */
-)
+static uint32_t NOVATELGPS_syncEvents(NovatelGPS* gps)
 {
-    uint32_t ulTemp1;
-    uint32_t ulTemp2;
-    uint32_t ulCRC = 0;
+    // Anything that passed a CRC, a checksum or matched a reply proves the rate
+    return gps->frameCount + gps->nmea.sentenceCount + gps->replyCount;
+}
 
-    while ( ulCount-- != 0 )
+static void NOVATELGPS_sendCommand(NovatelGPS* gps)
+{
+    // Called with the queue idle, from an interrupt or with interrupts masked
+    while(gps->commandHead != gps->commandTail)
     {
-        ulTemp1 = ( ulCRC >> 8 ) & 0x00FFFFFFL;
-        ulTemp2 = CRC32Value( ((int) ((ulCRC) ^ (*ucBuffer)) ) & 0xff );
-        ucBuffer++;
-        ulCRC = ulTemp1 ^ ulTemp2;
+        NovatelCommand* command = &gps->commands[gps->commandHead];
+
+        gps->commandState = GPS_CMD_SENDING_ST;
+        gps->commandTick = HAL_GetTick();
+
+        if(HAL_UART_Transmit_IT(gps->UARTInterface, (uint8_t*) command->text, command->length) == HAL_OK)
+            return;
+
+        // Transmitter busy or in error, report it and try the next one
+        NOVATELGPS_finishCommand(gps, GPS_CMD_TX_ERROR);
     }
-    return( ulCRC );
+}
+
+static void NOVATELGPS_finishCommand(NovatelGPS* gps, uint8_t status)
+{
+    NovatelCommand* command = &gps->commands[gps->commandHead];
+
+    if(status == GPS_CMD_OK)
+        gps->commandsOk++;
+    else
+        gps->commandsFailed++;
+
+    // Slot is released after the callback, so the text is still valid there
+    if(command->callback != NULL)
+        command->callback(command->text, status, command->context);
+
+    gps->commandHead = (gps->commandHead + 1) & (GPS_COMMANDS - 1);
+    gps->commandState = GPS_CMD_IDLE_ST;
 }
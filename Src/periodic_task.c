@@ -0,0 +1,79 @@
+/**
+ ******************************************************************************
+ * @file      periodic_task.c
+ * @author    Gabriel F P Araujo
+ * @date      17/10/2026
+ ******************************************************************************
+ *
+ * @attention Copyright (C) 2018
+ * @attention Laboratório de Automação e Robótica (LARA)
+ * @attention Departamento de Engenharia Elétrica (ENE)
+ * @attention Universidade de Brasília (UnB)
+ */
+
+#include <string.h>
+#include "stm32f1xx_hal.h"
+#include "cmsis_os.h"
+#include "timestamp.h"
+#include "periodic_task.h"
+
+static uint8_t PERIODIC_bin(uint32_t jitter);
+
+void PERIODIC_init(PeriodicTask* task, uint32_t rateHz)
+{
+    // Wakes only fall on ticks
+    if((rateHz == 0) || ((configTICK_RATE_HZ % rateHz) != 0))
+    {
+        Error_Handler();
+    }
+
+    memset(task, 0, sizeof(PeriodicTask));
+    task->period = configTICK_RATE_HZ / rateHz;
+    task->periodUs = 1000000 / rateHz;
+    task->lastWake = xTaskGetTickCount();
+}
+
+void PERIODIC_wait(PeriodicTask* task)
+{
+    TickType_t lastWake = task->lastWake;
+    uint64_t wakeTime;
+    uint32_t jitter;
+
+    // The body used up the period: the wait returns at once, the next
+    // cycles run late until the tick grid is caught up again
+    if((TickType_t)(xTaskGetTickCount() - lastWake) >= task->period)
+        task->overruns++;
+
+    vTaskDelayUntil(&lastWake, task->period);
+    task->lastWake = lastWake;
+
+    wakeTime = TIMESTAMP_now();
+    if(task->cycles == 0)
+    {
+        task->firstWakeTime = wakeTime;
+    }
+    else
+    {
+        int64_t interval = (int64_t)(wakeTime - task->wakeTime) - task->periodUs;
+
+        jitter = (uint32_t)((interval < 0) ? -interval : interval);
+        if(jitter > task->jitterMax)
+            task->jitterMax = jitter;
+        task->histogram[PERIODIC_bin(jitter)]++;
+
+        task->meanPeriod = (uint32_t)(((wakeTime - task->firstWakeTime) * 1000) / task->cycles);
+    }
+    task->wakeTime = wakeTime;
+    task->cycles++;
+}
+
+static uint8_t PERIODIC_bin(uint32_t jitter)
+{
+    uint8_t bin = 0;
+
+    // Doubling bins from PERIODIC_BIN0_US, the last one open ended
+    for(jitter /= PERIODIC_BIN0_US; (jitter > 0) && (bin < PERIODIC_BINS - 1); jitter >>= 1)
+        bin++;
+
+    return bin;
+}
@@ -0,0 +1,84 @@
+/**
+ ******************************************************************************
+ * @file      sample_bus.c
+ * @author    Gabriel F P Araujo
+ * @date      17/10/2026
+ ******************************************************************************
+ *
+ * @attention Copyright (C) 2018
+ * @attention Laboratório de Automação e Robótica (LARA)
+ * @attention Departamento de Engenharia Elétrica (ENE)
+ * @attention Universidade de Brasília (UnB)
+ */
+
+#include <string.h>
+#include "stm32f1xx_hal.h"
+#include "sample_bus.h"
+
+void SAMPLEBUS_init(SampleTopic* topic, void* data, uint16_t size, uint32_t capacity)
+{
+    // Free running counts only index correctly with a power of two
+    if((capacity < 2) || ((capacity & (capacity - 1)) != 0))
+    {
+        Error_Handler();
+    }
+
+    topic->data = (uint8_t*) data;
+    topic->size = size;
+    topic->capacity = capacity;
+    topic->mask = capacity - 1;
+    topic->head = 0;
+}
+
+void SAMPLEBUS_publish(SampleTopic* topic, const void* sample)
+{
+    uint32_t head = topic->head;
+
+    memcpy(&topic->data[(head & topic->mask) * topic->size], sample, topic->size);
+
+    // Published last: the sample is whole before any subscriber can see it
+    __DMB();
+    topic->head = head + 1;
+}
+
+void SAMPLEBUS_subscribe(SampleTopic* topic, SampleSubscriber* subscriber)
+{
+    subscriber->topic = topic;
+    subscriber->cursor = topic->head;
+    subscriber->overruns = 0;
+}
+
+int8_t SAMPLEBUS_read(SampleSubscriber* subscriber, void* sample)
+{
+    SampleTopic* topic = subscriber->topic;
+
+    for(;;)
+    {
+        uint32_t cursor = subscriber->cursor;
+        uint32_t head = topic->head;
+
+        if(head == cursor)
+            return 0;
+
+        // Lapped: skip to the oldest sample the producer is not writing
+        if(head - cursor >= topic->capacity)
+        {
+            subscriber->overruns += head - cursor - (topic->capacity - 1);
+            cursor = head - (topic->capacity - 1);
+        }
+
+        __DMB();
+        memcpy(sample, &topic->data[(cursor & topic->mask) * topic->size], topic->size);
+        __DMB();
+
+        // Whole if the producer did not start on the sample that reuses the
+        // slot (cursor + capacity) while it was copied, otherwise try again
+        if(topic->head - cursor < topic->capacity)
+        {
+            subscriber->cursor = cursor + 1;
+            return 1;
+        }
+
+        subscriber->cursor = cursor;
+    }
+}
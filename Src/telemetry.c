@@ -0,0 +1,94 @@
+/**
+ ******************************************************************************
+ * @file      telemetry.c
+ * @author    Gabriel F P Araujo
+ * @date      17/10/2026
+ ******************************************************************************
+ *
+ * @attention Copyright (C) 2018
+ * @attention Laboratório de Automação e Robótica (LARA)
+ * @attention Departamento de Engenharia Elétrica (ENE)
+ * @attention Universidade de Brasília (UnB)
+ */
+
+#include <string.h>
+#include "stm32f1xx_hal.h"
+#include "novatel_crc.h"
+#include "telemetry.h"
+
+static uint16_t TELEMETRY_cobs(const uint8_t* data, uint16_t length, uint8_t* encoded);
+
+void TELEMETRY_init(Telemetry* telemetry, uint8_t* buffer, uint16_t size)
+{
+    telemetry->buffer = buffer;
+    telemetry->size = size;
+    telemetry->length = 0;
+    telemetry->records = 0;
+}
+
+uint8_t TELEMETRY_fits(const Telemetry* telemetry, uint16_t payloadLength)
+{
+    return (telemetry->size - telemetry->length) >= TELEMETRY_RECORD_SIZE(payloadLength);
+}
+
+int8_t TELEMETRY_add(Telemetry* telemetry, uint8_t stream, uint16_t sequence, uint64_t time, const void* payload, uint16_t payloadLength)
+{
+    uint8_t record[TELEMETRY_HEADER + TELEMETRY_MAX_PAYLOAD + TELEMETRY_CRC];
+    uint16_t length = TELEMETRY_HEADER + payloadLength;
+    uint32_t crc;
+
+    if((payloadLength > TELEMETRY_MAX_PAYLOAD) || !TELEMETRY_fits(telemetry, payloadLength))
+        return 0;
+
+    // Little-endian target: the fields are copied as they are in memory
+    record[0] = stream;
+    memcpy(&record[1], &sequence, 2);
+    memcpy(&record[3], &time, 8);
+    memcpy(&record[TELEMETRY_HEADER], payload, payloadLength);
+
+    crc = NOVATELCRC_block(NOVATEL_CRC_INIT, record, length);
+    memcpy(&record[length], &crc, TELEMETRY_CRC);
+    length += TELEMETRY_CRC;
+
+    telemetry->length += TELEMETRY_cobs(record, length, &telemetry->buffer[telemetry->length]);
+    telemetry->buffer[telemetry->length++] = 0x00;
+    telemetry->records++;
+
+    return 1;
+}
+
+void TELEMETRY_clear(Telemetry* telemetry)
+{
+    telemetry->length = 0;
+}
+
+static uint16_t TELEMETRY_cobs(const uint8_t* data, uint16_t length, uint8_t* encoded)
+{
+    // Each block starts with the distance to the next zero (or to the end of
+    // a full 254 byte block), the zeros themselves are dropped
+    uint8_t* code = encoded;
+    uint8_t* out = encoded + 1;
+    uint8_t run = 1;
+
+    for(uint16_t i = 0; i < length; i++)
+    {
+        if(data[i] == 0)
+        {
+            *code = run;
+            code = out++;
+            run = 1;
+            continue;
+        }
+
+        *out++ = data[i];
+        if(++run == 0xFF)
+        {
+            *code = run;
+            code = out++;
+            run = 1;
+        }
+    }
+    *code = run;
+
+    return (uint16_t)(out - encoded);
+}
@@ -0,0 +1,57 @@
+/**
+ ******************************************************************************
+ * @file      timestamp.c
+ * @author    Gabriel F P Araujo
+ * @date      17/10/2026
+ ******************************************************************************
+ *
+ * @attention Copyright (C) 2018
+ * @attention Laboratório de Automação e Robótica (LARA)
+ * @attention Departamento de Engenharia Elétrica (ENE)
+ * @attention Universidade de Brasília (UnB)
+ */
+
+#include "stm32f1xx_hal.h"
+#include "timestamp.h"
+
+static uint32_t TIMESTAMP_cyclesPerUs;
+static uint32_t TIMESTAMP_lastCycles;
+static uint32_t TIMESTAMP_remainder;
+static uint64_t TIMESTAMP_micros;
+
+void TIMESTAMP_init(void)
+{
+    TIMESTAMP_cyclesPerUs = SystemCoreClock / 1000000;
+    TIMESTAMP_lastCycles = 0;
+    TIMESTAMP_remainder = 0;
+    TIMESTAMP_micros = 0;
+
+    // Cycle counter is part of the trace unit, off after reset
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+uint64_t TIMESTAMP_now(void)
+{
+    uint64_t now;
+    uint32_t cycles, elapsed;
+
+    // Read and extension must not be split by another caller
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    // Unsigned difference is right across one wrap. Leftover cycles are
+    // carried so the microseconds do not drift
+    cycles = DWT->CYCCNT;
+    elapsed = (cycles - TIMESTAMP_lastCycles) + TIMESTAMP_remainder;
+    TIMESTAMP_lastCycles = cycles;
+
+    TIMESTAMP_micros += elapsed / TIMESTAMP_cyclesPerUs;
+    TIMESTAMP_remainder = elapsed % TIMESTAMP_cyclesPerUs;
+    now = TIMESTAMP_micros;
+
+    __set_PRIMASK(primask);
+
+    return now;
+}
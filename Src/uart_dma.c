@@ -0,0 +1,122 @@
+/**
+ ******************************************************************************
+ * @file      uart_dma.c
+ * @author    Gabriel F P Araujo
+ * @date      17/10/2026
+ ******************************************************************************
+ *
+ * @attention Copyright (C) 2018
+ * @attention Laboratório de Automação e Robótica (LARA)
+ * @attention Departamento de Engenharia Elétrica (ENE)
+ * @attention Universidade de Brasília (UnB)
+ */
+
+#include "stm32f1xx_hal.h"
+#include "main.h"
+#include "uart_dma.h"
+
+/* Private function prototypes -----------------------------------------------*/
+static void UARTDMA_arm(UARTDMARx* rx);
+
+/* Body Functions ------------------------------------------------------------*/
+void UARTDMA_start(UARTDMARx* rx, UART_HandleTypeDef* interface, uint8_t* buffer, uint16_t size, UARTDMASpanCallback callback, void* context)
+{
+    rx->UARTInterface = interface;
+    rx->buffer = buffer;
+    rx->bufferSize = size;
+    rx->restarts = 0;
+    rx->spanCallback = callback;
+    rx->callbackContext = context;
+
+    UARTDMA_arm(rx);
+}
+
+void UARTDMA_irqHandler(UARTDMARx* rx)
+{
+    UART_HandleTypeDef* huart = rx->UARTInterface;
+
+    // Line went idle after a burst, hand over what the DMA wrote so far
+    if((__HAL_UART_GET_FLAG(huart, UART_FLAG_IDLE) != RESET) && (__HAL_UART_GET_IT_SOURCE(huart, UART_IT_IDLE) != RESET))
+    {
+        // IDLE is cleared by reading SR then DR
+        __HAL_UART_CLEAR_IDLEFLAG(huart);
+        UARTDMA_rxEvent(rx);
+    }
+}
+
+void UARTDMA_rxEvent(UARTDMARx* rx)
+{
+    // DMA counts down the bytes left until the buffer wraps
+    uint16_t head = rx->bufferSize - __HAL_DMA_GET_COUNTER(rx->UARTInterface->hdmarx);
+
+    if(head == rx->bufferSize)
+        head = 0;
+
+    if(head == rx->tail)
+        return;
+
+    if(head > rx->tail)
+    {
+        rx->spanCallback(&rx->buffer[rx->tail], head - rx->tail, rx->callbackContext);
+    }
+    else
+    {
+        // Buffer wrapped: end of the buffer first, then its start
+        rx->spanCallback(&rx->buffer[rx->tail], rx->bufferSize - rx->tail, rx->callbackContext);
+        if(head != 0)
+            rx->spanCallback(rx->buffer, head, rx->callbackContext);
+    }
+
+    rx->tail = head;
+}
+
+void UARTDMA_restart(UARTDMARx* rx)
+{
+    // HAL has stopped the DMA: hand over what arrived before the error and
+    // start again from the beginning of the buffer
+    UARTDMA_rxEvent(rx);
+    rx->restarts++;
+    UARTDMA_arm(rx);
+}
+
+void UARTDMA_setBaudRate(UARTDMARx* rx, uint32_t baudRate)
+{
+    UART_HandleTypeDef* huart = rx->UARTInterface;
+
+    // DMA and IDLE interrupts also move the tail, keep them out
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    // Hand over what arrived at the old rate and stop the circular transfer
+    UARTDMA_rxEvent(rx);
+    if(HAL_UART_AbortReceive(huart) != HAL_OK)
+    {
+        Error_Handler();
+    }
+
+    // Handle is initialised, so only the registers are written (no MspInit)
+    huart->Init.BaudRate = baudRate;
+    if(HAL_UART_Init(huart) != HAL_OK)
+    {
+        Error_Handler();
+    }
+
+    UARTDMA_arm(rx);
+
+    __set_PRIMASK(primask);
+}
+
+static void UARTDMA_arm(UARTDMARx* rx)
+{
+    rx->tail = 0;
+
+    // Channel is configured in circular mode (HAL_UART_MspInit), so this runs forever
+    if(HAL_UART_Receive_DMA(rx->UARTInterface, rx->buffer, rx->bufferSize) != HAL_OK)
+    {
+        Error_Handler();
+    }
+
+    // Half/full transfer interrupts are enabled by HAL, IDLE is not
+    __HAL_UART_CLEAR_IDLEFLAG(rx->UARTInterface);
+    __HAL_UART_ENABLE_IT(rx->UARTInterface, UART_IT_IDLE);
+}
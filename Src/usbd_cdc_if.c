@@ -51,6 +51,7 @@
 #include "usbd_cdc_if.h"
 
 /* USER CODE BEGIN INCLUDE */
+#include <string.h>
 
 /* USER CODE END INCLUDE */
 
@@ -94,7 +95,9 @@
 /* Define size for the receive and transmit buffer over CDC */
 /* It's up to user to redefine and/or remove those define */
 #define APP_RX_DATA_SIZE  1000
-#define APP_TX_DATA_SIZE  1000
+/* Transmit queue, a power of two */
+#define APP_TX_DATA_SIZE  2048
+#define APP_TX_DATA_MASK  (APP_TX_DATA_SIZE - 1)
 /* USER CODE END PRIVATE_DEFINES */
 
 /**
@@ -127,6 +130,13 @@ uint8_t UserRxBufferFS[APP_RX_DATA_SIZE];
 uint8_t UserTxBufferFS[APP_TX_DATA_SIZE];
 
 /* USER CODE BEGIN PRIVATE_VARIABLES */
+/* Transmit queue on UserTxBufferFS, free running indexes: the writers
+   advance txHead, the end of each transfer advances txTail */
+static volatile uint32_t txHead;
+static volatile uint32_t txTail;
+static uint32_t txLength;       /* Transfer under way, 0 when none */
+static uint8_t txZlp;           /* Last transfer ended on a full packet */
+static uint32_t txRefused;
 
 /* USER CODE END PRIVATE_VARIABLES */
 
@@ -158,8 +168,10 @@ static int8_t CDC_Init_FS(void);
 static int8_t CDC_DeInit_FS(void);
 static int8_t CDC_Control_FS(uint8_t cmd, uint8_t* pbuf, uint16_t length);
 static int8_t CDC_Receive_FS(uint8_t* pbuf, uint32_t *Len);
+static int8_t CDC_TransmitCplt_FS(uint8_t *pbuf, uint32_t *Len, uint8_t epnum);
 
 /* USER CODE BEGIN PRIVATE_FUNCTIONS_DECLARATION */
+static void CDC_TxStart(void);
 
 /* USER CODE END PRIVATE_FUNCTIONS_DECLARATION */
 
@@ -172,7 +184,8 @@ USBD_CDC_ItfTypeDef USBD_Interface_fops_FS =
   CDC_Init_FS,
   CDC_DeInit_FS,
   CDC_Control_FS,
-  CDC_Receive_FS
+  CDC_Receive_FS,
+  CDC_TransmitCplt_FS
 };
 
 /* Private functions ---------------------------------------------------------*/
@@ -186,6 +199,9 @@ static int8_t CDC_Init_FS(void)
   /* Set Application Buffers */
   USBD_CDC_SetTxBuffer(&hUsbDeviceFS, UserTxBufferFS, 0);
   USBD_CDC_SetRxBuffer(&hUsbDeviceFS, UserRxBufferFS);
+  /* A transfer cut by a reset is sent again, the next write starts it */
+  txLength = 0;
+  txZlp = 0;
   return (USBD_OK);
   /* USER CODE END 3 */
 }
@@ -302,28 +318,140 @@ static int8_t CDC_Receive_FS(uint8_t* Buf, uint32_t *Len)
   *         Data to send over USB IN endpoint are sent over CDC interface
   *         through this function.
   *         @note
-  *
+  *         The data is copied to the transmit queue, Buf is free on return.
+  *         Callable from any task. Writes queued while a transfer is under
+  *         way go out together in the next one, chained from its end.
   *
   * @param  Buf: Buffer of data to be sent
   * @param  Len: Number of data to be sent (in bytes)
-  * @retval USBD_OK if all operations are OK else USBD_FAIL or USBD_BUSY
+  * @retval USBD_OK if queued, USBD_BUSY if the queue has no room for all of
+  *         it (nothing is queued then)
   */
 uint8_t CDC_Transmit_FS(uint8_t* Buf, uint16_t Len)
 {
   uint8_t result = USBD_OK;
   /* USER CODE BEGIN 7 */
-  USBD_CDC_HandleTypeDef *hcdc = (USBD_CDC_HandleTypeDef*)hUsbDeviceFS.pClassData;
-  if (hcdc->TxState != 0){
+  uint32_t primask = __get_PRIMASK();
+  uint32_t head;
+  uint32_t first;
+
+  /* Writers exclude each other and the USB interrupt, the copy is short */
+  __disable_irq();
+  head = txHead;
+  if ((APP_TX_DATA_SIZE - (head - txTail)) < Len)
+  {
+    txRefused++;
+    __set_PRIMASK(primask);
     return USBD_BUSY;
   }
-  USBD_CDC_SetTxBuffer(&hUsbDeviceFS, Buf, Len);
-  result = USBD_CDC_TransmitPacket(&hUsbDeviceFS);
+
+  first = APP_TX_DATA_SIZE - (head & APP_TX_DATA_MASK);
+  if (first > Len)
+  {
+    first = Len;
+  }
+  memcpy(&UserTxBufferFS[head & APP_TX_DATA_MASK], Buf, first);
+  memcpy(UserTxBufferFS, &Buf[first], Len - first);
+  txHead = head + Len;
+
+  CDC_TxStart();
+  __set_PRIMASK(primask);
   /* USER CODE END 7 */
   return result;
 }
 
+/**
+  * @brief  CDC_TransmitCplt_FS
+  *         Data transmited callback
+  *
+  *         @note
+  *         This function is IN transfer complete callback used to inform user that
+  *         the submitted Data is successfully sent over USB.
+  *
+  * @param  Buf: Buffer of data sent
+  * @param  Len: Number of data sent (in bytes)
+  * @param  epnum: IN endpoint number
+  * @retval Result of the operation: USBD_OK if all operations are OK else USBD_FAIL
+  */
+static int8_t CDC_TransmitCplt_FS(uint8_t *Buf, uint32_t *Len, uint8_t epnum)
+{
+  uint8_t result = USBD_OK;
+  /* USER CODE BEGIN 13 */
+  UNUSED(Buf);
+  UNUSED(Len);
+  UNUSED(epnum);
+  /* USB interrupt: frees what was sent and starts on what was queued since */
+  txTail += txLength;
+  txLength = 0;
+  CDC_TxStart();
+  /* USER CODE END 13 */
+  return result;
+}
+
 /* USER CODE BEGIN PRIVATE_FUNCTIONS_IMPLEMENTATION */
 
+/**
+  * @brief  CDC_TxFree_FS
+  *         Room in the transmit queue. Only this writer can take it up when
+  *         the others are idle, else a hint.
+  * @retval Bytes a CDC_Transmit_FS can queue
+  */
+uint16_t CDC_TxFree_FS(void)
+{
+  return (uint16_t)(APP_TX_DATA_SIZE - (txHead - txTail));
+}
+
+/**
+  * @brief  CDC_TxRefused_FS
+  * @retval Writes refused for lack of room in the transmit queue
+  */
+uint32_t CDC_TxRefused_FS(void)
+{
+  return txRefused;
+}
+
+/**
+  * @brief  CDC_TxStart
+  *         Sends everything queued in one transfer, up to the end of the
+  *         buffer, when the endpoint is idle. The USB interrupt is held off
+  *         or running.
+  * @retval None
+  */
+static void CDC_TxStart(void)
+{
+  USBD_CDC_HandleTypeDef *hcdc = (USBD_CDC_HandleTypeDef*)hUsbDeviceFS.pClassData;
+  uint32_t tail = txTail;
+  uint32_t length = txHead - tail;
+
+  /* No class data before the host configures the device */
+  if ((hcdc == NULL) || (hcdc->TxState != 0))
+  {
+    return;
+  }
+
+  if (length == 0)
+  {
+    /* The host ends a read at a short packet: a transfer ending on a full
+       one is closed with a zero length packet once the queue runs dry */
+    if (txZlp)
+    {
+      txZlp = 0;
+      USBD_CDC_SetTxBuffer(&hUsbDeviceFS, UserTxBufferFS, 0);
+      USBD_CDC_TransmitPacket(&hUsbDeviceFS);
+    }
+    return;
+  }
+
+  if (length > (APP_TX_DATA_SIZE - (tail & APP_TX_DATA_MASK)))
+  {
+    length = APP_TX_DATA_SIZE - (tail & APP_TX_DATA_MASK);
+  }
+  txLength = length;
+  txZlp = ((length % CDC_DATA_FS_MAX_PACKET_SIZE) == 0);
+  USBD_CDC_SetTxBuffer(&hUsbDeviceFS, &UserTxBufferFS[tail & APP_TX_DATA_MASK], length);
+  USBD_CDC_TransmitPacket(&hUsbDeviceFS);
+}
+
 /* USER CODE END PRIVATE_FUNCTIONS_IMPLEMENTATION */
 
 /**
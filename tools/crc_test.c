@@ -0,0 +1,234 @@
+/**
+ ******************************************************************************
+ * @file      crc_test.c
+ * @author    Gabriel F P Araujo
+ * @date      17/10/2026
+ ******************************************************************************
+ *
+ * @attention Copyright (C) 2018
+ * @attention Laboratório de Automação e Robótica (LARA)
+ * @attention Departamento de Engenharia Elétrica (ENE)
+ * @attention Universidade de Brasília (UnB)
+ *
+ *
+ *
+ ******************************************************************************
+ *
+ ** ### NovAtel CRC-32 host test ###
+ *
+ *  Checks the table (NOVATELCRC_update) and slicing-by-4 (NOVATELCRC_block)
+ *  CRCs of novatel_crc.c bit for bit against the bitwise CRC32Value code they
+ *  replaced, then times the three. Built on the host, not part of the
+ *  firmware:
+ *
+ *      cc -O2 -I Inc -o crc_test tools/crc_test.c && ./crc_test
+ *
+ *  (#) Known frames    The BESTPOSB/BESTPOSA examples of the NovAtel manual
+ *                      and the CRC catalogue check string
+ *  (#) Random buffers  Every length up to 600 at every alignment, plus large
+ *                      random buffers
+ *  (#) Benchmark       MB/s and ns per byte of each variant
+ *
+ *  Exits with 1 on any mismatch.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define NOVATEL_CRC_SLICE4
+#include "../Src/novatel_crc.c"
+
+#define CRC32_POLYNOMIAL    0xEDB88320UL
+#define BENCH_SIZE          (1024 * 1024)
+#define BENCH_ROUNDS        64
+
+// BESTPOSB example of the NovAtel OEM manual, CRC in the last 4 bytes
+static const uint8_t bestposb[] =
+{
+    0xAA, 0x44, 0x12, 0x1C, 0x2A, 0x00, 0x02, 0x20, 0x48, 0x00, 0x00, 0x00, 0x90, 0xB4,
+    0x93, 0x05, 0xB0, 0xAB, 0xB9, 0x12, 0x00, 0x00, 0x00, 0x00, 0x45, 0x61, 0xBC, 0x0A,
+    0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x1B, 0x04, 0x50, 0xB3, 0xF2, 0x8E,
+    0x49, 0x40, 0x16, 0xFA, 0x6B, 0xBE, 0x7C, 0x82, 0x5C, 0xC0, 0x00, 0x60, 0x76, 0x9F,
+    0x44, 0x9F, 0x90, 0x40, 0xA6, 0x2A, 0x82, 0xC1, 0x3D, 0x00, 0x00, 0x00, 0x12, 0x5A,
+    0xCB, 0x3F, 0xCD, 0x9E, 0x98, 0x3F, 0xDB, 0x66, 0x40, 0x40, 0x00, 0x30, 0x30, 0x30,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0B, 0x0B, 0x00, 0x00, 0x00, 0x06,
+    0x00, 0x03, 0x42, 0xDC, 0x4C, 0x48
+};
+
+// BESTPOSA example of the same manual: CRC of the text between '#' and '*'
+static const char bestposa[] =
+    "BESTPOSA,COM1,0,78.0,FINESTEERING,1427,325298.000,00000000,6145,2748;"
+    "SOL_COMPUTED,SINGLE,51.11678928753,-114.03886216575,1064.3470,-16.2708,WGS84,"
+    "2.3434,1.3043,4.7300,\"\",0.000,0.000,7,7,0,0,0,06,0,03";
+#define BESTPOSA_CRC    0x9C9A92BBUL
+
+static const char check[] = "123456789";
+#define CHECK_CRC       0x2DFD2D88UL
+
+static uint8_t buffer[BENCH_SIZE + 4];
+static int failures = 0;
+
+/* Reference: the code NovAtel publishes, as it was in novatel_gps.c --------*/
+
+static uint32_t CRC32Value(int i)
+{
+    int j;
+    uint32_t ulCRC;
+    ulCRC = i;
+
+    for ( j = 8 ; j > 0; j-- )
+    {
+        if ( ulCRC & 1 )
+            ulCRC = ( ulCRC >> 1 ) ^ CRC32_POLYNOMIAL;
+        else
+            ulCRC >>= 1;
+    }
+    return ulCRC;
+}
+
+static uint32_t CalculateBlockCRC32(uint32_t ulCount, const uint8_t *ucBuffer)
+{
+    uint32_t ulTemp1;
+    uint32_t ulTemp2;
+    uint32_t ulCRC = 0;
+
+    while ( ulCount-- != 0 )
+    {
+        ulTemp1 = ( ulCRC >> 8 ) & 0x00FFFFFFL;
+        ulTemp2 = CRC32Value( ((int) ((ulCRC) ^ (*ucBuffer)) ) & 0xff );
+        ucBuffer++;
+        ulCRC = ulTemp1 ^ ulTemp2;
+    }
+    return( ulCRC );
+}
+
+/* Variants under test -------------------------------------------------------*/
+
+// What the framers do, one byte at a time as they arrive
+static uint32_t tableCrc(const uint8_t* data, uint32_t count)
+{
+    uint32_t crc = NOVATEL_CRC_INIT;
+
+    while(count-- != 0)
+        crc = NOVATELCRC_update(crc, *data++);
+
+    return crc;
+}
+
+static uint32_t slice4Crc(const uint8_t* data, uint32_t count)
+{
+    return NOVATELCRC_block(NOVATEL_CRC_INIT, data, count);
+}
+
+static void expect(const char* name, uint32_t value, uint32_t expected)
+{
+    if(value != expected)
+    {
+        printf("FAIL %s: 0x%08lX, expected 0x%08lX\n", name, (unsigned long)value, (unsigned long)expected);
+        failures++;
+    }
+}
+
+static void knownFrames(void)
+{
+    uint32_t length = sizeof(bestposb) - 4;
+    uint32_t sent = bestposb[length] | (bestposb[length + 1] << 8) |
+                    ((uint32_t)bestposb[length + 2] << 16) | ((uint32_t)bestposb[length + 3] << 24);
+
+    expect("bestposb bitwise", CalculateBlockCRC32(length, bestposb), sent);
+    expect("bestposb table", tableCrc(bestposb, length), sent);
+    expect("bestposb slice4", slice4Crc(bestposb, length), sent);
+    // Over the CRC too the remainder is zero
+    expect("bestposb residue", slice4Crc(bestposb, sizeof(bestposb)), 0);
+
+    length = sizeof(bestposa) - 1;
+    expect("bestposa bitwise", CalculateBlockCRC32(length, (const uint8_t*)bestposa), BESTPOSA_CRC);
+    expect("bestposa table", tableCrc((const uint8_t*)bestposa, length), BESTPOSA_CRC);
+    expect("bestposa slice4", slice4Crc((const uint8_t*)bestposa, length), BESTPOSA_CRC);
+
+    length = sizeof(check) - 1;
+    expect("check table", tableCrc((const uint8_t*)check, length), CHECK_CRC);
+    expect("check slice4", slice4Crc((const uint8_t*)check, length), CHECK_CRC);
+}
+
+static void randomBuffers(void)
+{
+    uint32_t length;
+    uint32_t offset;
+    uint32_t i;
+
+    for(i = 0; i < sizeof(buffer); i++)
+        buffer[i] = (uint8_t)rand();
+
+    for(length = 0; length <= 600; length++)
+    {
+        for(offset = 0; offset < 4; offset++)
+        {
+            uint32_t reference = CalculateBlockCRC32(length, &buffer[offset]);
+
+            if((tableCrc(&buffer[offset], length) != reference) ||
+               (slice4Crc(&buffer[offset], length) != reference))
+            {
+                printf("FAIL random length %lu offset %lu\n", (unsigned long)length, (unsigned long)offset);
+                failures++;
+            }
+        }
+    }
+
+    // Incremental: a block split anywhere gives the CRC of the whole
+    for(i = 0; i < 1000; i++)
+    {
+        uint32_t split;
+
+        length = 1 + rand() % 4096;
+        split = rand() % length;
+        expect("split", NOVATELCRC_block(NOVATELCRC_block(NOVATEL_CRC_INIT, buffer, split), &buffer[split], length - split),
+               CalculateBlockCRC32(length, buffer));
+    }
+}
+
+static double seconds(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static void bench(const char* name, uint32_t (*crc)(const uint8_t*, uint32_t), uint32_t rounds)
+{
+    volatile uint32_t sink = 0;
+    double start = seconds();
+    double elapsed;
+    uint32_t i;
+
+    for(i = 0; i < rounds; i++)
+        sink ^= crc(&buffer[i & 3], BENCH_SIZE);
+    elapsed = seconds() - start;
+    (void)sink;
+
+    printf("%-8s %8.1f MB/s %7.2f ns/byte\n", name, (double)rounds * BENCH_SIZE / elapsed / 1e6,
+           elapsed * 1e9 / ((double)rounds * BENCH_SIZE));
+}
+
+static uint32_t bitwiseCrc(const uint8_t* data, uint32_t count)
+{
+    return CalculateBlockCRC32(count, data);
+}
+
+int main(void)
+{
+    srand(1);
+
+    knownFrames();
+    randomBuffers();
+    printf("%s\n", failures ? "bit-exact: FAIL" : "bit-exact: ok");
+
+    bench("bitwise", bitwiseCrc, BENCH_ROUNDS / 8);
+    bench("table", tableCrc, BENCH_ROUNDS);
+    bench("slice4", slice4Crc, BENCH_ROUNDS);
+
+    return failures ? 1 : 0;
+}
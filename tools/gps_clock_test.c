@@ -0,0 +1,172 @@
+/**
+ ******************************************************************************
+ * @file      gps_clock_test.c
+ * @author    Gabriel F P Araujo
+ * @date      17/10/2026
+ ******************************************************************************
+ *
+ * @attention Copyright (C) 2018
+ * @attention Laboratório de Automação e Robótica (LARA)
+ * @attention Departamento de Engenharia Elétrica (ENE)
+ * @attention Universidade de Brasília (UnB)
+ *
+ *
+ *
+ ******************************************************************************
+ *
+ ** ### GPS clock host test ###
+ *
+ *  Drives gps_clock.c with synthetic 20 Hz frame streams from a receiver
+ *  whose output latency jitters, seen by a local clock that runs off rate,
+ *  and checks GPSCLOCK_gpsTimeFromLocal against the true GPS time. Built on
+ *  the host, not part of the firmware:
+ *
+ *      cc -O2 -I tools/host -I Inc -o gps_clock_test tools/gps_clock_test.c && ./gps_clock_test
+ *
+ *  (#) Frames      Latency 15 ms + 0..3 ms jitter, 5 % of the frames 20 to
+ *                  60 ms late, stamps off by up to a byte time. The
+ *                  least delayed latency goes into the offset: the error
+ *                  has to settle at -15 ms within 1 ms
+ *  (#) PPS         Same frames plus edges with 2 us of jitter: the error
+ *                  has to settle within 50 us, without the frame latency
+ *  (#) Local jump  The local clock jumps 20 ms: the model has to re-step
+ *                  and settle again
+ *
+ *  Exits with 1 on any failure.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../Src/gps_clock.c"
+
+#define START_WEEK      2200
+#define START_TOW_US    100000000ULL
+#define FRAME_US        50000
+#define LATENCY_US      15000
+#define JITTER_US       3000
+#define BYTE_TIME_US    87      // 115200 baud
+#define SETTLE_US       30000000ULL
+#define RUN_US          120000000ULL
+
+typedef struct
+{
+    const char* name;
+    double rateError;           // Local clock rate error [ppm], fast when positive
+    uint8_t pps;
+    uint64_t jumpAt;            // [us] into the run, 0 for none
+    int64_t jump;               // [us] added to the local clock
+    int64_t expectedError;      // Settled gps - true [us]
+    int64_t tolerance;
+}Scenario;
+
+static int failures = 0;
+
+static uint64_t gpsStart(void)
+{
+    return (uint64_t)START_WEEK*GPS_WEEK_US + START_TOW_US;
+}
+
+// Local clock reading at true GPS time t
+static uint64_t localAt(const Scenario* scenario, uint64_t t)
+{
+    uint64_t elapsed = t - gpsStart();
+    uint64_t local = 1000000 + elapsed + (int64_t)(elapsed * scenario->rateError * 1e-6);
+
+    if((scenario->jumpAt != 0) && (elapsed >= scenario->jumpAt))
+        local += scenario->jump;
+
+    return local;
+}
+
+static int64_t uniform(int64_t range)
+{
+    return (range > 0) ? (rand() % range) : 0;
+}
+
+static void run(const Scenario* scenario)
+{
+    GPSClock clock;
+    uint64_t t;
+    uint64_t nextPps = gpsStart() + 1000000;
+    int64_t worst = 0;
+    int64_t sum = 0;
+    uint32_t checks = 0;
+
+    GPSCLOCK_init(&clock);
+
+    for(t = gpsStart(); t < gpsStart() + RUN_US; t += FRAME_US)
+    {
+        int64_t latency = LATENCY_US + uniform(JITTER_US);
+        uint64_t tow;
+        uint64_t probe;
+        uint64_t elapsed = t - gpsStart();
+
+        if(uniform(100) < 5)
+            latency += 20000 + uniform(40000);
+
+        // Edge first: the frame naming its second comes after it
+        if(scenario->pps && (t >= nextPps))
+        {
+            GPSCLOCK_pps(&clock, localAt(scenario, nextPps) + uniform(5) - 2);
+            nextPps += 1000000;
+        }
+
+        tow = t - (uint64_t)START_WEEK*GPS_WEEK_US;
+        GPSCLOCK_frame(&clock, START_WEEK, (uint32_t)(tow / 1000),
+                       localAt(scenario, t + latency) + uniform(2*BYTE_TIME_US) - BYTE_TIME_US);
+
+        // Settled: check an instant between frames, away from a jump
+        if((elapsed < SETTLE_US) || ((scenario->jumpAt != 0) && (elapsed >= scenario->jumpAt) &&
+                                     (elapsed < scenario->jumpAt + SETTLE_US)))
+            continue;
+
+        probe = t + uniform(FRAME_US);
+        {
+            int64_t error = (int64_t)(GPSCLOCK_gpsTimeFromLocal(&clock, localAt(scenario, probe)) - probe);
+            int64_t deviation = error - scenario->expectedError;
+
+            if(deviation < 0)
+                deviation = -deviation;
+            if(deviation > worst)
+                worst = deviation;
+            sum += error;
+            checks++;
+        }
+    }
+
+    printf("%-12s error mean %8.1f us, worst %6lld us off %lld | rate %+8.3f ppm (true %+8.3f) | "
+           "updates %lu outliers %lu steps %lu\n",
+           scenario->name, (double)sum / checks, (long long)worst, (long long)scenario->expectedError,
+           -(double)clock.drift * 1e6 / 4294967296.0, scenario->rateError,
+           (unsigned long)clock.updates, (unsigned long)clock.outliers, (unsigned long)clock.steps);
+
+    if(worst > scenario->tolerance)
+    {
+        printf("FAIL %s: worst %lld us, tolerance %lld us\n", scenario->name, (long long)worst, (long long)scenario->tolerance);
+        failures++;
+    }
+    if((scenario->jumpAt != 0) && (clock.steps < 2))
+    {
+        printf("FAIL %s: the jump did not re-step the model\n", scenario->name);
+        failures++;
+    }
+}
+
+int main(void)
+{
+    const Scenario scenarios[] =
+    {
+        {"frames",     +40.0, 0, 0,        0,     -LATENCY_US, 1000},
+        {"frames slow", -120.0, 0, 0,      0,     -LATENCY_US, 1000},
+        {"pps",        +40.0, 1, 0,        0,     0,           50},
+        {"local jump", +40.0, 0, 60000000, 20000, -LATENCY_US, 1000},
+    };
+
+    srand(1);
+
+    for(uint32_t i = 0; i < sizeof(scenarios)/sizeof(scenarios[0]); i++)
+        run(&scenarios[i]);
+
+    printf("%s\n", failures ? "FAIL" : "ok");
+    return failures ? 1 : 0;
+}
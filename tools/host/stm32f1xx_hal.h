@@ -0,0 +1,72 @@
+/**
+ ******************************************************************************
+ * @file      stm32f1xx_hal.h
+ * @author    Gabriel F P Araujo
+ * @date      17/10/2026
+ ******************************************************************************
+ *
+ * @attention Copyright (C) 2018
+ * @attention Laboratório de Automação e Robótica (LARA)
+ * @attention Departamento de Engenharia Elétrica (ENE)
+ * @attention Universidade de Brasília (UnB)
+ *
+ *
+ *
+ ******************************************************************************
+ *
+ ** ### Host stand-in for the HAL ###
+ *
+ *  Lets the host tests in tools/ build driver sources unchanged: only what
+ *  those sources touch, single threaded, so interrupt masking does nothing.
+ */
+
+#ifndef STM32F1XX_HAL_H
+#define STM32F1XX_HAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+typedef enum
+{
+    HAL_OK = 0,
+    HAL_ERROR
+}HAL_StatusTypeDef;
+
+typedef struct
+{
+    uint32_t BaudRate;
+}UART_InitTypeDef;
+
+typedef struct
+{
+    UART_InitTypeDef Init;
+}UART_HandleTypeDef;
+
+// No line behind it: blocking reads fail
+static inline HAL_StatusTypeDef HAL_UART_Receive(UART_HandleTypeDef* huart, uint8_t* data, uint16_t size, uint32_t timeout)
+{
+    (void)huart;
+    (void)data;
+    (void)size;
+    (void)timeout;
+    return HAL_ERROR;
+}
+
+#define Error_Handler() abort()
+
+static inline uint32_t __get_PRIMASK(void)
+{
+    return 0;
+}
+
+static inline void __disable_irq(void)
+{
+}
+
+static inline void __set_PRIMASK(uint32_t primask)
+{
+    (void)primask;
+}
+
+#endif /* STM32F1XX_HAL_H */
@@ -0,0 +1,227 @@
+/**
+ ******************************************************************************
+ * @file      nanoimu_framer_test.c
+ * @author    Gabriel F P Araujo
+ * @date      17/10/2026
+ ******************************************************************************
+ *
+ * @attention Copyright (C) 2018
+ * @attention Laboratório de Automação e Robótica (LARA)
+ * @attention Departamento de Engenharia Elétrica (ENE)
+ * @attention Universidade de Brasília (UnB)
+ *
+ *
+ *
+ ******************************************************************************
+ *
+ ** ### NanoIMU push framer host test ###
+ *
+ *  Builds a stream of NanoIMU packets with junk between them and pushes it
+ *  through NANOIMU_pushBytes in random span sizes, as the DMA would. Built
+ *  on the host, not part of the firmware:
+ *
+ *      cc -O2 -I tools/host -I Inc -o nanoimu_framer_test tools/nanoimu_framer_test.c && ./nanoimu_framer_test
+ *
+ *  (#) Packets     Random payloads, a serial number in the reserved bytes
+ *                  9 to 12 and the timer stepping one sample period
+ *  (#) Junk        Random bytes, runs of 0xFF (sync look-alikes cut short
+ *                  or too long) and whole packets with a bad checksum
+ *  (#) Checks      Every packet decoded exactly once, in order, with its
+ *                  own bytes and timer ticks, and nothing else decoded
+ *
+ *  Junk never holds a packet start (four 0xFF and the size byte) that runs
+ *  into the next packet: with an 8 bit checksum such a false start is
+ *  accepted once in 256, which no framer can tell apart.
+ *
+ *  Exits with 1 on any failure.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../Src/memsense_nanoimu.c"
+
+#define PACKETS         20000
+#define JUNK_MAX        80
+#define SPAN_MAX        300
+#define STREAM_SIZE     (PACKETS * (IMU_PACKET_SIZE + JUNK_MAX + IMU_PACKET_SIZE))
+#define SERIAL_BYTE     9       // Reserved bytes 9 to 12: marker and serial
+#define MARK_PACKET     0x00
+#define MARK_JUNK       0x80
+#define TIMER_STEP      (NANOIMU_TIMER_HZ / NANOIMU_RATE_HZ)
+
+static uint8_t packets[PACKETS][IMU_PACKET_SIZE];
+static uint8_t stream[STREAM_SIZE];
+static uint32_t decoded[PACKETS];
+static uint32_t expectedSerial = 0;
+static uint64_t firstTicks;
+static int failures = 0;
+
+// Breaks every packet start from the offset on: four 0xFF and the size
+static void breakSync(uint8_t* data, uint32_t length, uint32_t from)
+{
+    uint32_t run = 0;
+
+    for(uint32_t i = 0; i < length; i++)
+    {
+        if((i >= from) && (run >= MSG_SIZE) && (data[i] == D_MSG_SIZE))
+            data[i] = 0x00;
+        run = (data[i] == D_SYNC) ? run + 1 : 0;
+    }
+}
+
+static void buildPacket(uint8_t* packet, uint8_t mark, uint32_t serial, uint16_t timer)
+{
+    uint8_t sum = 0;
+
+    packet[SYNC0] = D_SYNC;
+    packet[SYNC1] = D_SYNC;
+    packet[SYNC2] = D_SYNC;
+    packet[SYNC3] = D_SYNC;
+    packet[MSG_SIZE] = D_MSG_SIZE;
+    packet[DEV_ID] = D_DEV_ID;
+    packet[MSG_ID] = D_MSG_ID;
+    packet[TIME_MSB] = timer >> 8;
+    packet[TIME_LSB] = timer & 0xFF;
+    packet[SERIAL_BYTE] = mark;
+    packet[SERIAL_BYTE + 1] = (serial >> 16) & 0xFF;
+    packet[SERIAL_BYTE + 2] = (serial >> 8) & 0xFF;
+    packet[SERIAL_BYTE + 3] = serial & 0xFF;
+
+    // Payload rich in 0xFF, so a rejected packet has sync look-alikes to rescan
+    for(uint32_t i = GYRX_MSB; i < CHECKSUM; i++)
+        packet[i] = (rand() % 4 == 0) ? D_SYNC : (uint8_t)rand();
+    breakSync(packet, CHECKSUM, GYRX_MSB);
+
+    for(uint32_t i = 0; i < CHECKSUM; i++)
+        sum += packet[i];
+    packet[CHECKSUM] = sum;
+}
+
+static uint32_t buildJunk(uint8_t* junk)
+{
+    uint32_t length = 0;
+
+    switch(rand() % 4)
+    {
+        case 0:
+            // Nothing between the packets
+            break;
+
+        case 1:
+            // Random bytes
+            length = rand() % JUNK_MAX;
+            for(uint32_t i = 0; i < length; i++)
+                junk[i] = (uint8_t)rand();
+            break;
+
+        case 2:
+            // A run of sync bytes, short or long, maybe with the size after it
+            length = 1 + rand() % 8;
+            memset(junk, D_SYNC, length);
+            if(rand() % 2)
+                junk[length++] = (uint8_t)rand();
+            break;
+
+        case 3:
+            // Whole packet that fails its checksum
+            buildPacket(junk, MARK_JUNK, rand() & 0xFFFFFF, (uint16_t)rand());
+            junk[CHECKSUM] += 1 + rand() % 255;
+            length = IMU_PACKET_SIZE;
+            break;
+    }
+
+    return length;
+}
+
+static void packetCallback(const MEMSenseSample* sample, void* context)
+{
+    MEMSenseImu* nanoImu = (MEMSenseImu*) context;
+    const uint8_t* data = nanoImu->data;
+    uint32_t serial = ((uint32_t)data[SERIAL_BYTE + 1] << 16) | (data[SERIAL_BYTE + 2] << 8) | data[SERIAL_BYTE + 3];
+
+    if((data[SERIAL_BYTE] != MARK_PACKET) || (serial >= PACKETS) ||
+       (memcmp(data, packets[serial], IMU_PACKET_SIZE) != 0))
+    {
+        printf("FAIL false frame (marker 0x%02X, serial %lu)\n", data[SERIAL_BYTE], (unsigned long)serial);
+        failures++;
+        return;
+    }
+
+    if(serial != expectedSerial)
+    {
+        printf("FAIL packet %lu out of order, expected %lu\n", (unsigned long)serial, (unsigned long)expectedSerial);
+        failures++;
+    }
+    expectedSerial = serial + 1;
+    decoded[serial]++;
+
+    // Timer extension: nothing is lost, every packet is one period later
+    if(serial == 0)
+        firstTicks = sample->ticks;
+    else if(sample->ticks != firstTicks + (uint64_t)serial * TIMER_STEP)
+    {
+        printf("FAIL packet %lu ticks %llu, expected %llu\n", (unsigned long)serial,
+               (unsigned long long)sample->ticks, (unsigned long long)(firstTicks + (uint64_t)serial * TIMER_STEP));
+        failures++;
+    }
+}
+
+int main(void)
+{
+    static MEMSenseImu nanoImu;
+    UART_HandleTypeDef uart;
+    uint32_t length = 0;
+    uint32_t offset;
+    uint32_t spans = 0;
+    uint32_t missing = 0;
+    uint32_t repeated = 0;
+
+    srand(1);
+
+    for(uint32_t i = 0; i < PACKETS; i++)
+    {
+        uint32_t back = (length < 8) ? length : 8;
+        uint32_t junk = buildJunk(&stream[length]);
+
+        // With the bytes before it: a run may start in the previous junk
+        breakSync(&stream[length - back], back + junk, back);
+        length += junk;
+        buildPacket(packets[i], MARK_PACKET, i, (uint16_t)(i * TIMER_STEP));
+        memcpy(&stream[length], packets[i], IMU_PACKET_SIZE);
+        length += IMU_PACKET_SIZE;
+    }
+
+    uart.Init.BaudRate = NANOIMU_BPS;
+    NANOIMU_configDevice(&nanoImu, &uart);
+    NANOIMU_setPacketCallback(&nanoImu, packetCallback, &nanoImu);
+
+    for(offset = 0; offset < length; spans++)
+    {
+        uint32_t span = 1 + rand() % SPAN_MAX;
+
+        if(span > length - offset)
+            span = length - offset;
+        NANOIMU_pushBytes(&nanoImu, &stream[offset], span);
+        offset += span;
+    }
+
+    for(uint32_t i = 0; i < PACKETS; i++)
+    {
+        if(decoded[i] == 0)
+            missing++;
+        else if(decoded[i] > 1)
+            repeated++;
+    }
+    if(missing || repeated)
+    {
+        printf("FAIL %lu packets missing, %lu decoded more than once\n", (unsigned long)missing, (unsigned long)repeated);
+        failures++;
+    }
+
+    printf("%lu bytes in %lu spans: %lu packets, %lu recovered by a rescan, %lu bytes discarded\n",
+           (unsigned long)length, (unsigned long)spans, (unsigned long)nanoImu.packetCount,
+           (unsigned long)nanoImu.packetsRecovered, (unsigned long)nanoImu.bytesDiscarded);
+    printf("%s\n", failures ? "FAIL" : "ok");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,159 @@
+#!/usr/bin/env python3
+"""Reference decoder of the binary telemetry (Inc/telemetry.h).
+
+Reads the USB CDC byte stream from a file, a serial device or stdin, splits
+it at the 0x00 delimiters, COBS decodes and CRC checks each record, and
+prints one line per record. Sequence gaps are reported per stream, a summary
+of records, CRC errors and lost samples is printed at the end. Record times
+in GPS time (us from the GPS epoch) are printed with a G prefix.
+
+    stty -F /dev/ttyACM0 raw && python3 telemetry_decode.py /dev/ttyACM0
+    python3 telemetry_decode.py capture.bin
+"""
+
+import struct
+import sys
+import zlib
+
+NANOIMU, MPU6050, GPS, SCHED, STATUS = 1, 2, 3, 4, 5
+GPS_TIME = 0x80
+STREAM_NAMES = {NANOIMU: "nanoimu", MPU6050: "mpu6050", GPS: "gps",
+                SCHED: "sched", STATUS: "status"}
+
+HEADER = struct.Struct("<BHQ")
+CRC = struct.Struct("<I")
+
+# Q31 fraction of 2^range: gyro, accel, (mag), temperature ranges per stream
+NANOIMU_SCALE = [2.0**3] * 3 + [2.0**5] * 3 + [2.0**2] * 3 + [2.0**11] * 3
+MPU6050_SCALE = [2.0**6] * 3 + [2.0**8] * 3 + [2.0**8]
+
+GPS_RECORD = struct.Struct("<HIIB3d3fI3d3f")
+SCHED_RECORD = struct.Struct("<B12I")
+STATUS_RECORD = struct.Struct("<B3Q6IBI16s")
+SCHED_TASKS = {0: "telemetry", 1: "gps"}
+
+
+def novatel_crc(data):
+    # Reflected 0xEDB88320, initial value 0, no final XOR: zlib's CRC-32
+    # without its inversions
+    return zlib.crc32(data, 0xFFFFFFFF) ^ 0xFFFFFFFF
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            raise ValueError("bad COBS block")
+        out += data[i + 1:i + code]
+        i += code
+        # A block shorter than 255 stood for a zero, except the last one
+        if code < 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def q31(channels, scale):
+    return [c * s / 2.0**31 for c, s in zip(channels, scale)]
+
+
+def format_payload(stream, payload):
+    if stream == NANOIMU and len(payload) == 48:
+        values = q31(struct.unpack("<12i", payload), NANOIMU_SCALE)
+        return " ".join("%.5f" % v for v in values)
+    if stream == MPU6050 and len(payload) == 28:
+        values = q31(struct.unpack("<7i", payload), MPU6050_SCALE)
+        return " ".join("%.5f" % v for v in values)
+    if stream == GPS and len(payload) == GPS_RECORD.size:
+        f = GPS_RECORD.unpack(payload)
+        return ("week %d ms %d pstat %d svs %d pos %.3f %.3f %.3f sigma %.3f %.3f %.3f "
+                "vstat %d vel %.3f %.3f %.3f sigma %.3f %.3f %.3f" % f)
+    if stream == SCHED and len(payload) == SCHED_RECORD.size:
+        f = SCHED_RECORD.unpack(payload)
+        return ("%s cycles %d overruns %d jitterMax %d us meanPeriod %d ns hist %s"
+                % (SCHED_TASKS.get(f[0], f[0]), f[1], f[2], f[3], f[4], list(f[5:])))
+    if stream == STATUS and len(payload) == STATUS_RECORD.size:
+        f = STATUS_RECORD.unpack(payload)
+        text = ("valid %#x newest %d %d %d overruns %d %d %d refused %d fifoOverflows %d "
+                "packetsDropped %d" % f[:10])
+        if f[10]:
+            text += " error %s:%d" % (f[12].rstrip(b"\0").decode("ascii", "replace"), f[11])
+        return text
+    return payload.hex()
+
+
+class Decoder:
+    def __init__(self, out):
+        self.out = out
+        self.pending = bytearray()
+        self.records = 0
+        self.errors = 0
+        self.next_sequence = {}
+        self.lost = {}
+
+    def feed(self, data):
+        self.pending += data
+        while True:
+            end = self.pending.find(b"\x00")
+            if end < 0:
+                return
+            frame = bytes(self.pending[:end])
+            del self.pending[:end + 1]
+            if frame:
+                self.record(frame)
+
+    def record(self, frame):
+        try:
+            data = cobs_decode(frame)
+        except ValueError:
+            self.errors += 1
+            return
+        if len(data) < HEADER.size + CRC.size:
+            self.errors += 1
+            return
+        body, (crc,) = data[:-CRC.size], CRC.unpack(data[-CRC.size:])
+        if novatel_crc(body) != crc:
+            self.errors += 1
+            return
+
+        stream, sequence, time = HEADER.unpack(body[:HEADER.size])
+        time_base = "G" if stream & GPS_TIME else ""
+        stream &= ~GPS_TIME
+        payload = body[HEADER.size:]
+        self.records += 1
+
+        # Sequences are per stream, 16 bit; SCHED shares STATUS's counter
+        if stream != SCHED:
+            expected = self.next_sequence.get(stream)
+            if expected is not None and sequence != expected:
+                gap = (sequence - expected) & 0xFFFF
+                self.lost[stream] = self.lost.get(stream, 0) + gap
+                self.out.write("# %s lost %d\n" % (STREAM_NAMES.get(stream, stream), gap))
+            self.next_sequence[stream] = (sequence + 1) & 0xFFFF
+
+        self.out.write("%s %d %s%d %s\n" % (STREAM_NAMES.get(stream, stream), sequence, time_base, time,
+                                            format_payload(stream, payload)))
+
+    def summary(self):
+        lost = ", ".join("%s %d" % (STREAM_NAMES.get(s, s), n) for s, n in sorted(self.lost.items()))
+        self.out.write("# records %d, crc/framing errors %d, lost: %s\n"
+                       % (self.records, self.errors, lost or "none"))
+
+
+def main():
+    source = open(sys.argv[1], "rb", buffering=0) if len(sys.argv) > 1 else sys.stdin.buffer
+    decoder = Decoder(sys.stdout)
+    try:
+        while True:
+            data = source.read(4096)
+            if not data:
+                break
+            decoder.feed(data)
+    except KeyboardInterrupt:
+        pass
+    decoder.summary()
+
+
+if __name__ == "__main__":
+    main()